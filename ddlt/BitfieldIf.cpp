@@ -288,6 +288,14 @@ int DDLT::Bitfield::getNameHash( lua_State* L )
   return 1;
 }
 
+int DDLT::Bitfield::getContentHash( lua_State* L )
+{
+  Bitfield* self = Check( L, 1 );
+
+  lua_pushnumber( L, self->m_Bitfield->GetContentHash() );
+  return 1;
+}
+
 int DDLT::Bitfield::getNumFlags( lua_State* L )
 {
   Bitfield* self = Check( L, 1 );
@@ -413,6 +421,9 @@ int DDLT::Bitfield::l__index( lua_State* L )
   case 0x2709d01bU: // getNameHash
     lua_pushcfunction( L, getNameHash );
     return 1;
+  case 0xf716ba26U: // getContentHash
+    lua_pushcfunction( L, getContentHash );
+    return 1;
   case 0xb9621bc2U: // getNumFlags
     lua_pushcfunction( L, getNumFlags );
     return 1;
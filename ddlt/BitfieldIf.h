@@ -26,6 +26,7 @@ namespace DDLT
     static int getLabel( lua_State* L );
     static int getDisplayLabel( lua_State* L );
     static int getNameHash( lua_State* L );
+    static int getContentHash( lua_State* L );
     static int getNumFlags( lua_State* L );
     static int getDefaultFlag( lua_State* L );
     static int getFlag( lua_State* L );
@@ -27,7 +27,7 @@ int DDLT::Compiler::compile( lua_State* L )
   LinearAllocator scratch;
   scratch.Init( 64 * 1024 * 1024 );
 
-  DDLParser::Definition* definition = DDLParser::Compile( &self->m_Definition, &scratch, source, source_size, error, sizeof( error ), self->m_TwoUSReserved, self->m_BitfieldLimit );
+  DDLParser::Definition* definition = DDLParser::Compile( &self->m_Definition, &scratch, source, source_size, error, sizeof( error ), self->m_TwoUSReserved, self->m_BitfieldLimit, DDLParser::kCompileContentHashes );
 
   scratch.Destroy();
 
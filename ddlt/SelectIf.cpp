@@ -254,6 +254,14 @@ int DDLT::Select::getNameHash( lua_State* L )
   return 1;
 }
 
+int DDLT::Select::getContentHash( lua_State* L )
+{
+  Select* self = Check( L, 1 );
+
+  lua_pushnumber( L, self->m_Select->GetContentHash() );
+  return 1;
+}
+
 int DDLT::Select::getNumItems( lua_State* L )
 {
   Select* self = Check( L, 1 );
@@ -379,6 +387,9 @@ int DDLT::Select::l__index( lua_State* L )
   case 0x2709d01bU: // getNameHash
     lua_pushcfunction( L, getNameHash );
     return 1;
+  case 0xf716ba26U: // getContentHash
+    lua_pushcfunction( L, getContentHash );
+    return 1;
   case 0x5379b335U: // getNumItems
     lua_pushcfunction( L, getNumItems );
     return 1;
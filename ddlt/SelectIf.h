@@ -26,6 +26,7 @@ namespace DDLT
     static int getLabel( lua_State* L );
     static int getDisplayLabel( lua_State* L );
     static int getNameHash( lua_State* L );
+    static int getContentHash( lua_State* L );
     static int getNumItems( lua_State* L );
     static int getDefaultItem( lua_State* L );
     static int getItem( lua_State* L );
@@ -701,6 +701,14 @@ int DDLT::Struct::getNameHash( lua_State* L )
   return 1;
 }
 
+int DDLT::Struct::getContentHash( lua_State* L )
+{
+  Struct* self = Check( L, 1 );
+
+  lua_pushnumber( L, self->m_Struct->GetContentHash() );
+  return 1;
+}
+
 int DDLT::Struct::getNumFields( lua_State* L )
 {
   Struct* self = Check( L, 1 );
@@ -943,6 +951,9 @@ int DDLT::Struct::l__index( lua_State* L )
   case 0x2709d01bU: // getNameHash
     lua_pushcfunction( L, getNameHash );
     return 1;
+  case 0xf716ba26U: // getContentHash
+    lua_pushcfunction( L, getContentHash );
+    return 1;
   case 0xf28b9251U: // getNumFields
     lua_pushcfunction( L, getNumFields );
     return 1;
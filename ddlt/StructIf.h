@@ -27,6 +27,7 @@ namespace DDLT
     static int getLabel( lua_State* L );
     static int getDisplayLabel( lua_State* L );
     static int getNameHash( lua_State* L );
+    static int getContentHash( lua_State* L );
     static int getNumFields( lua_State* L );
     static int getNumInheritedFields( lua_State* L );
     static int getNumOwnFields( lua_State* L );
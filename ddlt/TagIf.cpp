@@ -148,6 +148,12 @@ int DDLT::Tag::getType( lua_State* L )
   case DDLParser::kGeneric:
     lua_pushliteral( L, "generic" );
     return 1;
+  case DDLParser::kDefaultImage:
+    lua_pushliteral( L, "defaultimage" );
+    return 1;
+  case DDLParser::kContentHash:
+    lua_pushliteral( L, "contenthash" );
+    return 1;
   }
 
   return 0;
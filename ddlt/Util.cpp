@@ -85,6 +85,176 @@ static int Crc32( lua_State* L )
   return 1;
 }
 
+// Mixes the bits of a key, must match DDLMixHash in the generated code.
+static uint32_t MixHash( uint32_t h )
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
+
+// Moves the given keys into the slots given by the displacement if they're
+// all free, otherwise leaves the slots untouched and returns false.
+static bool PlaceBucket( const uint32_t* keys, const uint32_t* members, uint32_t size, uint32_t* slots, uint32_t count, uint32_t displacement )
+{
+  for ( uint32_t i = 0; i < size; i++ )
+  {
+    uint32_t slot = MixHash( keys[ members[ i ] ] ^ displacement ) % count;
+
+    if ( slots[ slot ] != 0 )
+    {
+      // Free the slots taken by the keys placed so far.
+      while ( i-- > 0 )
+      {
+        slots[ MixHash( keys[ members[ i ] ] ^ displacement ) % count ] = 0;
+      }
+
+      return false;
+    }
+
+    slots[ slot ] = members[ i ] + 1;
+  }
+
+  return true;
+}
+
+// Computes a minimal perfect hash for the given array of distinct 32-bit keys,
+// using hash and displace: keys are spread into as many buckets as there are
+// keys, and each bucket gets the displacement which moves all its keys into
+// free slots:
+//
+//   bucket = MixHash( key ^ seed ) % count
+//   slot   = MixHash( key ^ displacements[ bucket ] ) % count
+//
+// Returns a table with the seed, the displacements, and the 1-based index of
+// the key that went into each slot.
+static int PerfectHash( lua_State* L )
+{
+  luaL_checktype( L, 1, LUA_TTABLE );
+  uint32_t count = (uint32_t)lua_objlen( L, 1 );
+  luaL_argcheck( L, count != 0, 1, "no keys" );
+
+  // Scratch memory is taken from Lua, so it's collected if an error is raised.
+  uint32_t* keys          = (uint32_t*)lua_newuserdata( L, ( count * 7 + 1 ) * sizeof( uint32_t ) );
+  uint32_t* members       = keys + count;          // Keys sorted by bucket
+  uint32_t* order         = members + count;       // Buckets, largest first
+  uint32_t* displacements = order + count;         // Displacement of each bucket
+  uint32_t* slots         = displacements + count; // 1-based key in each slot, 0 if free
+  uint32_t* sizes         = slots + count;         // Number of keys in each bucket
+  uint32_t* starts        = sizes + count;         // First member of each bucket, and the end
+
+  for ( uint32_t i = 0; i < count; i++ )
+  {
+    lua_rawgeti( L, 1, i + 1 );
+    keys[ i ] = (uint32_t)luaL_checknumber( L, -1 );
+    lua_pop( L, 1 );
+
+    for ( uint32_t j = 0; j < i; j++ )
+    {
+      if ( keys[ j ] == keys[ i ] )
+      {
+        return luaL_error( L, "Duplicate key 0x%08x", keys[ i ] );
+      }
+    }
+  }
+
+  for ( uint32_t seed = 0; seed < 1024; seed++ )
+  {
+    memset( sizes, 0, count * sizeof( uint32_t ) );
+    memset( displacements, 0, count * sizeof( uint32_t ) );
+    memset( slots, 0, count * sizeof( uint32_t ) );
+
+    // Sort the keys by bucket, counting the keys already sorted into each
+    // bucket in the displacements.
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+      sizes[ MixHash( keys[ i ] ^ seed ) % count ]++;
+    }
+
+    starts[ 0 ] = 0;
+
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+      starts[ i + 1 ] = starts[ i ] + sizes[ i ];
+    }
+
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+      uint32_t bucket = MixHash( keys[ i ] ^ seed ) % count;
+      members[ starts[ bucket ] + displacements[ bucket ]++ ] = i;
+    }
+
+    memset( displacements, 0, count * sizeof( uint32_t ) );
+
+    // Place the largest buckets first, while most slots are still free.
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+      uint32_t j = i;
+
+      for ( ; j > 0 && sizes[ order[ j - 1 ] ] < sizes[ i ]; j-- )
+      {
+        order[ j ] = order[ j - 1 ];
+      }
+
+      order[ j ] = i;
+    }
+
+    bool found = true;
+
+    for ( uint32_t i = 0; i < count && found; i++ )
+    {
+      uint32_t bucket = order[ i ];
+
+      if ( sizes[ bucket ] == 0 )
+      {
+        break;
+      }
+
+      found = false;
+
+      for ( uint32_t displacement = 0; displacement < 65536 && !found; displacement++ )
+      {
+        found = PlaceBucket( keys, members + starts[ bucket ], sizes[ bucket ], slots, count, displacement );
+        displacements[ bucket ] = displacement;
+      }
+    }
+
+    if ( !found )
+    {
+      continue;
+    }
+
+    lua_createtable( L, 0, 3 );
+    lua_pushnumber( L, seed );
+    lua_setfield( L, -2, "seed" );
+
+    lua_createtable( L, count, 0 );
+
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+      lua_pushnumber( L, displacements[ i ] );
+      lua_rawseti( L, -2, i + 1 );
+    }
+
+    lua_setfield( L, -2, "displacements" );
+    lua_createtable( L, count, 0 );
+
+    for ( uint32_t i = 0; i < count; i++ )
+    {
+      lua_pushnumber( L, slots[ i ] );
+      lua_rawseti( L, -2, i + 1 );
+    }
+
+    lua_setfield( L, -2, "slots" );
+    return 1;
+  }
+
+  return luaL_error( L, "Couldn't find a perfect hash for %u keys", count );
+}
+
 // AStyle API sucks so we have to define this global
 static const char* s_AStyleError;
 
@@ -262,6 +432,9 @@ void RegisterFunctions( lua_State* L )
 
   lua_pushcfunction( L, GetSearchPaths );
   lua_setglobal( L, "getSearchPaths" );
+
+  lua_pushcfunction( L, PerfectHash );
+  lua_setglobal( L, "perfectHash" );
 }
 
 int CompareBoxedPointers( lua_State* L )
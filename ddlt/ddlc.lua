@@ -64,8 +64,12 @@ local function runTemplate( template_name, template_path, ddlc, first_aggregate,
 end
 
 local output = nil
+local outer_outputs = {}
 
+-- Output can be nested: after endOutput, emit goes back to the output that
+-- was being collected when beginOutput was called.
 function beginOutput()
+  outer_outputs[ #outer_outputs + 1 ] = output or false
   output = {}
 end
 
@@ -78,7 +82,7 @@ function emit( ... )
 end
 
 function endOutput()
-  output = nil
+  output = table.remove( outer_outputs ) or nil
 end
 
 function getOutput()
@@ -87,6 +91,99 @@ function getOutput()
   end
 end
 
+-- Formats the given code and writes it to a file.
+function writeCode( file_name, code )
+  local formatted, err = code:formatCode()
+
+  if not formatted then
+    error( err )
+  end
+
+  local file, err = io.open( file_name, 'w' )
+
+  if not file then
+    error( err )
+  end
+
+  file:write( formatted )
+  file:close()
+end
+
+-- Returns the name of a file written next to file_name, with the suffix
+-- added to its name and with another extension if one is given, i.e.
+-- test_ddl_2.cpp for ( 'test_ddl.cpp', '_2' ).
+function getSiblingFileName( file_name, suffix, extension )
+  local stem, ext = file_name:match( '^(.-)(%.[^%./\\]*)$' )
+
+  if not stem then
+    stem, ext = file_name, ''
+  end
+
+  return stem .. suffix .. ( extension or ext )
+end
+
+-- Writes the code generated for the aggregates to file_name, after the
+-- preamble shared by all of them. With more than one shard, the aggregates
+-- are spread across files named like file_name with _1 to _N added, which
+-- can be compiled in parallel. Each aggregate goes to the shard with the
+-- least code so far, largest first, and keeps its order within the shard.
+-- The preamble is then written once to a header with _shared added, which
+-- each shard includes after the banner.
+function writeShards( file_name, shards, banner, preamble, chunks )
+  if shards <= 1 then
+    writeCode( file_name, preamble .. table.concat( chunks ) )
+    return
+  end
+
+  local order, assigned, sizes = {}, {}, {}
+
+  for i = 1, #chunks do
+    order[ i ] = i
+  end
+
+  table.sort( order, function( a, b )
+    if #chunks[ a ] ~= #chunks[ b ] then
+      return #chunks[ a ] > #chunks[ b ]
+    end
+
+    return a < b
+  end )
+
+  for shard = 1, shards do
+    assigned[ shard ], sizes[ shard ] = {}, 0
+  end
+
+  for _, index in ipairs( order ) do
+    local smallest = 1
+
+    for shard = 2, shards do
+      if sizes[ shard ] < sizes[ smallest ] then
+        smallest = shard
+      end
+    end
+
+    local list = assigned[ smallest ]
+    list[ #list + 1 ] = index
+    sizes[ smallest ] = sizes[ smallest ] + #chunks[ index ]
+  end
+
+  local header = getSiblingFileName( file_name, '_shared', '.h' )
+  writeCode( header, preamble )
+
+  for shard = 1, shards do
+    local list = assigned[ shard ]
+    table.sort( list )
+
+    local code = { banner, '#include "', header:match( '[^/\\]*$' ), '"\n' }
+
+    for _, index in ipairs( list ) do
+      code[ #code + 1 ] = chunks[ index ]
+    end
+
+    writeCode( getSiblingFileName( file_name, '_' .. shard ), table.concat( code ) )
+  end
+end
+
 function checkSettings( settings, spec )
   for _, opt in ipairs( spec ) do
     if opt.short_name then
@@ -114,7 +114,9 @@ namespace DDLParser
     kKey,
     kUnits,
     kAbstract,
-    kGeneric
+    kGeneric,
+    kDefaultImage,
+    kContentHash
   };
 
   // The default string size if no size is given.
@@ -163,6 +165,8 @@ namespace DDLParser
   DEF_POINTER(StructFieldPtr, StructField);
   struct StructFieldRange;
   DEF_POINTER(StructFieldRangePtr, StructFieldRange);
+  struct DefaultImageFixup;
+  DEF_POINTER(DefaultImageFixupPtr, DefaultImageFixup);
 
   // BasicInfo is used in all aggregates and aggregate items.
   struct BasicInfo
@@ -316,6 +320,63 @@ namespace DDLParser
     GenericTagValue* operator[]( unsigned int index ) const;
   };
 
+  // A string pointer to be patched into a default image.
+  struct DefaultImageFixup
+  {
+    // Offset of the const char* in the image.
+    uint32_t m_Offset;
+    // The string it must point to.
+    String   m_Value;
+
+    uint32_t    GetOffset() const;
+    const char* GetValue() const;
+  };
+
+  // The default instance of a structure in its native layout (see
+  // GetNativeLayout), built by Compile when kCompileDefaultImages is given.
+  // All field defaults are resolved, including nested structure values,
+  // fixed arrays, select hashes and or'ed bitfield flags. Strings are NULL
+  // in the image and are patched by Instantiate.
+  struct DefaultImage: public Tag
+  {
+    // Size and alignment of the instance.
+    uint32_t             m_InstanceSize;
+    uint32_t             m_Alignment;
+    // The instance.
+    VoidPtr              m_Image;
+    // Strings to patch after copying the image.
+    uint32_t             m_NumFixups;
+    DefaultImageFixupPtr m_Fixups;
+    // Offsets of all fields, parent fields first.
+    uint32_t             m_NumFields;
+    uint32_t             m_FieldOffsets[ 0 ];
+
+    uint32_t                 GetInstanceSize() const;
+    uint32_t                 GetAlignment() const;
+    const void*              GetImage() const;
+    uint32_t                 GetNumFixups() const;
+    const DefaultImageFixup* GetFixup( uint32_t index ) const;
+    uint32_t                 GetNumFields() const;
+    uint32_t                 GetFieldOffset( uint32_t index ) const;
+
+    // Copies the image to instance and patches the strings. instance must
+    // have at least GetInstanceSize() bytes and be suitably aligned.
+    void                     Instantiate( void* instance ) const;
+  };
+
+  // The content hash of a select, bitfield or structure, stored by Compile
+  // when kCompileContentHashes is given.
+  // It covers the name, infos, items, flags, fields, types, default values
+  // and tags of the aggregate, and the content hashes of the aggregates its
+  // fields use, so a change in a select is also a change in the structures
+  // that use it.
+  struct ContentHash: public Tag
+  {
+    uint32_t m_Hash;
+
+    uint32_t GetHash() const;
+  };
+
   // Forward declare.
   struct Select;
   struct Bitfield;
@@ -349,6 +410,8 @@ namespace DDLParser
     const char* GetLabel() const;
     const char* GetDisplayLabel() const;
     uint32_t    GetNameHash() const;
+    // Returns the content hash, or 0 if the aggregate doesn't have one.
+    uint32_t    GetContentHash() const;
 
     // These methods return the aggregate cast to a specialized class. They
     // assert that the aggregate is convertible to the desired class.
@@ -602,6 +665,9 @@ namespace DDLParser
 
     // The schema crc reflects the type, count, name, and order of each field.  If any of those change, then the crc changes.  It does not reflect default values or any tags.
     uint32_t     GetSchemaCrc() const;
+
+    // Returns the default image, or NULL if it wasn't built by Compile.
+    DefaultImage* GetDefaultImage() const;
   };
 
   // The header of DDL binary data.
@@ -636,5 +702,169 @@ namespace DDLParser
     Aggregate* FindAggregate(uint32_t hash);
   };
 
-  Definition* Compile( LinearAllocator* definition, LinearAllocator* scratch, const void* source, size_t source_size, char* error, size_t error_size, bool two_us_reserved, int bitfield_limit );
+  // Dynamic arrays and hashmaps in native instances. Hashmap elements are
+  // key/value pairs laid out as a structure with two fields.
+  struct NativeArray
+  {
+    void*    m_Elements;
+    uint32_t m_Count;
+  };
+
+  // Size and alignment of a native instance.
+  struct NativeLayout
+  {
+    uint32_t m_Size;
+    uint32_t m_Alignment;
+    // Number of fields including the inherited ones.
+    uint32_t m_NumFields;
+  };
+
+  // Computes the native layout of a structure, i.e. how a C compiler lays out
+  // a struct declaring the parent structure first and then each field in
+  // order. Integers, floats and tuids have their natural sizes, booleans are
+  // uint8_t, selects and bitfields are uint32_t, strings, files, JSON and
+  // unknown types are const char*, structures are nested by value, fixed
+  // arrays are inline and dynamic arrays and hashmaps are NativeArray. If
+  // offsets isn't NULL, it receives the offset of each field.
+  NativeLayout GetNativeLayout( Definition* ddl, Struct* structure, uint32_t* offsets = 0 );
+  // Ditto, for one element of a field. Elements of hashmaps are the key/value
+  // pairs.
+  NativeLayout GetNativeLayout( Definition* ddl, const StructValueInfo* info );
+
+  // Precompiled serializer for instances of a structure in the native layout.
+  struct SerializerProgram;
+
+  // Compiles the serializer of a structure into program. The program is a
+  // flat list of ops, adjacent numeric fields are merged into one copy and
+  // arrays of plain elements are copied in bulk. Returns NULL on error.
+  SerializerProgram* CompileSerializer( LinearAllocator* program, LinearAllocator* scratch, Definition* ddl, Struct* structure, char* error, size_t error_size );
+  // Serializes an instance to buffer. Numbers are written in the host byte
+  // order, strings are prefixed with their length, and dynamic arrays and
+  // hashmaps with their count. Returns the number of bytes needed, nothing
+  // past buffer_size is written.
+  size_t Serialize( const SerializerProgram* program, const void* instance, void* buffer, size_t buffer_size );
+  // Fills an instance from buffer. Strings and arrays are allocated from
+  // allocator. Returns the number of bytes read, or 0 if the buffer is
+  // truncated or allocator is out of memory.
+  size_t Deserialize( const SerializerProgram* program, void* instance, const void* buffer, size_t buffer_size, LinearAllocator* allocator );
+
+  // Precompiled conversion of instances of a structure in the native layout
+  // from an old definition to a new one.
+  struct MigrationProgram;
+
+  // Compiles the conversion of the structure with the given name. Fields are
+  // matched by name, numbers are converted between types (saturating when
+  // narrowing), fixed arrays keep as many elements as fit, select items that
+  // were removed become the default item, bitfield flags are remapped by
+  // name, and fields that were added or changed incompatibly get their
+  // default values. new_ddl must be compiled with kCompileDefaultImages.
+  // Returns NULL on error.
+  MigrationProgram* CompileMigration( LinearAllocator* program, LinearAllocator* scratch, Definition* old_ddl, Definition* new_ddl, const char* name, char* error, size_t error_size );
+  // Converts num_records consecutive old instances to new ones. Strings and
+  // arrays that don't change are shared with the old records, converted
+  // arrays are allocated from allocator. Returns false if allocator is out
+  // of memory.
+  bool Migrate( const MigrationProgram* program, const void* old_records, void* new_records, size_t num_records, LinearAllocator* allocator );
+
+  // The kinds of differences between two definitions.
+  enum DiffType
+  {
+    kDiffAdded = 0,
+    kDiffRemoved,
+    kDiffChanged
+  };
+
+  // An aggregate that differs between two definitions. m_Old is NULL for
+  // added aggregates and m_New is NULL for removed ones.
+  struct DefinitionDiff
+  {
+    uint32_t   m_Type;
+    uint32_t   m_NameHash;
+    Aggregate* m_Old;
+    Aggregate* m_New;
+  };
+
+  // Matches the aggregates of two definitions by name and compares their
+  // content hashes. Aggregates without content hashes, i.e. compiled without
+  // kCompileContentHashes, are always changed.
+  // Writes at most max_diffs differences to diffs, sorted by name hash, and
+  // returns the total number of differences, or -1 if scratch is out of
+  // memory.
+  int32_t DiffDefinitions( Definition* old_ddl, Definition* new_ddl, LinearAllocator* scratch, DefinitionDiff* diffs, uint32_t max_diffs );
+  // Computes the content hash of each aggregate again and compares it with
+  // the stored one, i.e. to check a definition loaded from a container with
+  // both sections. Returns false if an aggregate has no content hash or a
+  // different one.
+  bool CheckContentHashes( Definition* ddl );
+
+  // Definition container (.ddlb) identification.
+  const uint32_t kContainerMagic   = 0x424c4444; // "DDLB"
+  const uint32_t kContainerVersion = 1;
+
+  // The sections of a container.
+  enum ContainerSectionType
+  {
+    // Names, hashes, types, indices, values and all other tags.
+    kSectionHot = 0,
+    // Authors, descriptions, labels, UI tags and JSON default values.
+    kSectionCold
+  };
+
+  // A section of the container, aligned to 8 bytes from its start.
+  struct ContainerSection
+  {
+    uint32_t m_Type;
+    uint32_t m_Offset;
+    uint32_t m_Size;
+    uint32_t m_Crc;
+  };
+
+  // The header at the start of a container, followed by the section table.
+  // The cold section is stored right after the hot one, and the definition
+  // expects to find it there.
+  struct ContainerHeader
+  {
+    uint32_t         m_Magic;
+    uint32_t         m_Version;
+    // Size of the header including the section table.
+    uint32_t         m_Size;
+    // The CompileOptions used to compile the definition.
+    uint32_t         m_Options;
+    // Crc32 of the DDL source.
+    uint32_t         m_SourceHash;
+    // Size of the hot and cold sections together.
+    uint32_t         m_DefinitionSize;
+    uint32_t         m_NumSections;
+    uint32_t         m_Reserved;
+    ContainerSection m_Sections[ 0 ];
+
+    // Returns the section with the given type, or NULL.
+    const ContainerSection* FindSection( uint32_t type ) const;
+  };
+
+  // Writes a definition to buffer as a container. The definition is repacked
+  // so that the cold strings follow the rest of it. Returns the number of
+  // bytes needed, nothing is written if it's greater than buffer_size, or 0
+  // if scratch is out of memory.
+  size_t WriteContainer( Definition* ddl, LinearAllocator* scratch, uint32_t options, uint32_t source_hash, void* buffer, size_t buffer_size );
+  // Returns the header if data starts with a valid header of the current
+  // version, or NULL.
+  const ContainerHeader* ReadContainerHeader( const void* data, size_t size );
+  // Copies the hot section to memory, which must have m_DefinitionSize
+  // bytes aligned to 8, and clears the room for the cold section so its
+  // strings read as empty. Returns NULL if the section is corrupt.
+  Definition* LoadHotSection( const ContainerHeader* header, const void* hot, void* memory );
+  // Copies the cold section in place. Returns false if it's corrupt.
+  bool LoadColdSection( const ContainerHeader* header, const void* cold, Definition* ddl );
+
+  // Options for Compile.
+  enum CompileOptions
+  {
+    // Build a DefaultImage for each structure.
+    kCompileDefaultImages = 1 << 0,
+    // Add a ContentHash tag to each select, bitfield and structure.
+    kCompileContentHashes = 1 << 1
+  };
+
+  Definition* Compile( LinearAllocator* definition, LinearAllocator* scratch, const void* source, size_t source_size, char* error, size_t error_size, bool two_us_reserved, int bitfield_limit, uint32_t options = 0 );
 };
@@ -0,0 +1,630 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include <DDLParser.h>
+
+#include "Layout.h"
+#include "GrowableArray.h"
+
+namespace DDLParser
+{
+  // A relative pointer in the definition.
+  struct RelPointer
+  {
+    uint32_t m_Offset;
+    // True if it points to a cold string.
+    uint32_t m_Cold;
+  };
+
+  // Cold strings moved to the cold section.
+  struct ColdRange
+  {
+    uint32_t m_Start;
+    uint32_t m_End;
+    uint32_t m_ColdOffset;
+  };
+
+  // Bytes removed from the hot section. Removals are multiples of 8 to keep
+  // the alignment of what comes after them, the rest of the cold bytes stay
+  // as zeroed padding.
+  struct Removal
+  {
+    uint32_t m_Start;
+    uint32_t m_Size;
+    uint32_t m_End;
+    // Total size removed before this one.
+    uint32_t m_Shift;
+  };
+
+  // Finds the location of all relative pointers in a definition.
+  struct PointerCollector
+  {
+    uint8_t*                   m_Base;
+    GrowableArray< RelPointer > m_Pointers;
+    uint32_t                   m_NumPointers;
+
+    void Add ( const void* pointer, bool cold )
+    {
+      if ( * ( const Offset* ) pointer != 0 )
+      {
+        RelPointer* rel = m_Pointers.Append();
+        rel->m_Offset = ( uint32_t ) ( ( const uint8_t* ) pointer - m_Base );
+        rel->m_Cold = cold;
+        m_NumPointers++;
+      }
+    }
+
+    void AddInfo ( const BasicInfo* info )
+    {
+      Add ( &info->m_Name, false );
+      Add ( &info->m_Author, true );
+      Add ( &info->m_Description, true );
+      Add ( &info->m_Label, true );
+    }
+
+    void AddTags ( const TagPtr* next );
+    void AddValueInfo ( const StructValueInfo* info );
+    void AddDefinition ( Definition* ddl );
+  };
+
+  void
+  PointerCollector::AddTags ( const TagPtr* next )
+  {
+    while ( next->m_Offset != 0 )
+    {
+      Add ( next, false );
+      Tag* tag = next->Get();
+
+      switch ( tag->m_Type )
+      {
+        case kExtensions:
+        case kVaultHints:
+        {
+          // Both have a count followed by the strings.
+          Extensions* extensions = ( Extensions* ) tag;
+          String* strings = ( String* ) ( ( uint8_t* ) tag + tag->m_Size );
+
+          for ( uint32_t i = 0; i < extensions->m_Count; i++ )
+          {
+            Add ( &strings[ i ], true );
+          }
+        }
+        break;
+        case kUIRender:
+          Add ( & ( ( UIRender* ) tag )->m_Render, true );
+          break;
+        case kParallel:
+          Add ( & ( ( Parallel* ) tag )->m_Array, false );
+          break;
+        case kVersion:
+          Add ( & ( ( Version* ) tag )->m_Version, false );
+          break;
+        case kCallback:
+          Add ( & ( ( Callback* ) tag )->m_Callback, false );
+          break;
+        case kKey:
+          Add ( & ( ( Key* ) tag )->m_Key, false );
+          break;
+        case kUnits:
+          Add ( & ( ( Units* ) tag )->m_Units, true );
+          break;
+        case kGeneric:
+        {
+          GenericTag* generic = ( GenericTag* ) tag;
+          GenericTagValue* values = ( GenericTagValue* ) ( ( uint8_t* ) tag + tag->m_Size );
+          Add ( &generic->m_Name, false );
+
+          for ( uint32_t i = 0; i < generic->m_NumValues; i++ )
+          {
+            if ( values[ i ].m_Type == kString )
+            {
+              Add ( &values[ i ].m_String, false );
+            }
+          }
+        }
+        break;
+        case kDefaultImage:
+        {
+          DefaultImage* image = ( DefaultImage* ) tag;
+          DefaultImageFixup* fixups = image->m_Fixups.Get();
+          Add ( &image->m_Image, false );
+          Add ( &image->m_Fixups, false );
+
+          for ( uint32_t i = 0; fixups != 0 && i < image->m_NumFixups; i++ )
+          {
+            Add ( &fixups[ i ].m_Value, false );
+          }
+        }
+        break;
+      }
+
+      next = &tag->m_Next;
+    }
+  }
+
+  void
+  PointerCollector::AddValueInfo ( const StructValueInfo* info )
+  {
+    if ( info->m_Type == kUnknown )
+    {
+      Add ( &info->m_TypeName, false );
+    }
+
+    Add ( &info->m_Value, false );
+    AddTags ( &info->m_Tags );
+
+    StructFieldValue* value = info->GetValue();
+    uint32_t count = info->GetCount();
+
+    for ( uint32_t i = 0; value != 0 && i < count; i++ )
+    {
+      switch ( info->m_Type )
+      {
+        case kString:
+        case kFile:
+          Add ( &value->m_String[ i ], false );
+          break;
+        case kJson:
+          Add ( &value->m_Json[ i ], true );
+          break;
+        case kBitfield:
+          Add ( &value->m_Bitfield[ i ], false );
+          break;
+        case kStruct:
+        {
+          StructStructValue* fields = value->m_Struct[ i ].Get();
+          Add ( &value->m_Struct[ i ], false );
+
+          for ( uint32_t j = 0; fields != 0 && j < fields->GetCount(); j++ )
+          {
+            AddValueInfo ( fields->GetValueInfo ( j ) );
+          }
+        }
+        break;
+        case kUnknown:
+        {
+          StructUnknownValue* ids = value->m_Unknown[ i ].Get();
+          Add ( &value->m_Unknown[ i ], false );
+
+          for ( uint32_t j = 0; ids != 0 && j < ids->m_Count; j++ )
+          {
+            String* strings = ( String* ) ( ( uint8_t* ) ids + ids->m_Size );
+            Add ( &strings[ j ], false );
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  void
+  PointerCollector::AddDefinition ( Definition* ddl )
+  {
+    AggregatePtr* aggregates = ( AggregatePtr* ) ( ( uint8_t* ) ddl + ddl->m_Size );
+
+    for ( uint32_t i = 0; i < ddl->m_NumAggregates; i++ )
+    {
+      Aggregate* aggregate = aggregates[ i ].Get();
+      Add ( &aggregates[ i ], false );
+      Add ( &aggregate->m_Name, false );
+      Add ( &aggregate->m_Author, true );
+      Add ( &aggregate->m_Description, true );
+      Add ( &aggregate->m_Label, true );
+
+      switch ( aggregate->m_Type )
+      {
+        case kSelect:
+        {
+          Select* select = aggregate->ToSelect();
+          SelectItemPtr* items = ( SelectItemPtr* ) ( ( uint8_t* ) select + select->m_Size );
+          AddTags ( &select->m_Tags );
+
+          for ( uint32_t j = 0; j < select->m_NumItems; j++ )
+          {
+            SelectItem* item = items[ j ].Get();
+            Add ( &items[ j ], false );
+            AddInfo ( item );
+            AddTags ( &item->m_Tags );
+          }
+        }
+        break;
+        case kBitfield:
+        {
+          Bitfield* bitfield = aggregate->ToBitfield();
+          BitfieldFlagPtr* flags = ( BitfieldFlagPtr* ) ( ( uint8_t* ) bitfield + bitfield->m_Size );
+          AddTags ( &bitfield->m_Tags );
+
+          for ( uint32_t j = 0; j < bitfield->m_NumFlags; j++ )
+          {
+            BitfieldFlag* flag = flags[ j ].Get();
+            Add ( &flags[ j ], false );
+            AddInfo ( flag );
+            Add ( &flag->m_Value, false );
+            AddTags ( &flag->m_Tags );
+          }
+        }
+        break;
+        case kStruct:
+        {
+          Struct* structure = aggregate->ToStruct();
+          StructFieldPtr* fields = ( StructFieldPtr* ) ( ( uint8_t* ) structure + structure->m_Size );
+          Add ( &structure->m_Parent, false );
+          Add ( &structure->m_Definition, false );
+          AddTags ( &structure->m_Tags );
+
+          // Only the structure's own fields, inherited ones are in the parent.
+          for ( uint32_t j = 0; j < structure->m_NumFields; j++ )
+          {
+            StructField* field = fields[ j ].Get();
+            Add ( &fields[ j ], false );
+            AddInfo ( field );
+            AddValueInfo ( &field->m_ValueInfo );
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  static int
+  CompareRelPointers ( const void* a, const void* b )
+  {
+    uint32_t offset_a = ( ( const RelPointer* ) a )->m_Offset;
+    uint32_t offset_b = ( ( const RelPointer* ) b )->m_Offset;
+    return offset_a < offset_b ? -1 : offset_a > offset_b ? 1 : 0;
+  }
+
+  static int
+  CompareColdRanges ( const void* a, const void* b )
+  {
+    uint32_t start_a = ( ( const ColdRange* ) a )->m_Start;
+    uint32_t start_b = ( ( const ColdRange* ) b )->m_Start;
+    return start_a < start_b ? -1 : start_a > start_b ? 1 : 0;
+  }
+
+  static int
+  CompareOffsets ( const void* a, const void* b )
+  {
+    uint32_t offset_a = * ( const uint32_t* ) a;
+    uint32_t offset_b = * ( const uint32_t* ) b;
+    return offset_a < offset_b ? -1 : offset_a > offset_b ? 1 : 0;
+  }
+
+  // Repacks a definition with the cold strings at the end.
+  struct Packer
+  {
+    uint8_t*    m_Base;
+    uint32_t    m_TotalSize;
+    RelPointer* m_Pointers;
+    uint32_t    m_NumPointers;
+    ColdRange*  m_Ranges;
+    uint32_t    m_NumRanges;
+    Removal*    m_Removals;
+    uint32_t    m_NumRemovals;
+    uint32_t    m_HotSize;
+    uint32_t    m_ColdSize;
+
+    uint32_t GetTarget ( const RelPointer* pointer ) const
+    {
+      return pointer->m_Offset + * ( const Offset* ) ( m_Base + pointer->m_Offset );
+    }
+
+    // Returns the new offset of a hot byte.
+    uint32_t Map ( uint32_t offset ) const
+    {
+      uint32_t low = 0, high = m_NumRemovals;
+
+      // Finds the first removal that ends after offset.
+      while ( low < high )
+      {
+        uint32_t middle = ( low + high ) / 2;
+
+        if ( m_Removals[ middle ].m_Start + m_Removals[ middle ].m_Size <= offset )
+        {
+          low = middle + 1;
+        }
+        else
+        {
+          high = middle;
+        }
+      }
+
+      return offset - ( low < m_NumRemovals ? m_Removals[ low ].m_Shift : m_TotalSize - m_HotSize );
+    }
+
+    // Returns the cold range containing offset, or NULL.
+    const ColdRange* FindRange ( uint32_t offset ) const
+    {
+      uint32_t low = 0, high = m_NumRanges;
+
+      while ( low < high )
+      {
+        uint32_t middle = ( low + high ) / 2;
+
+        if ( m_Ranges[ middle ].m_End <= offset )
+        {
+          low = middle + 1;
+        }
+        else
+        {
+          high = middle;
+        }
+      }
+
+      return low < m_NumRanges && m_Ranges[ low ].m_Start <= offset ? &m_Ranges[ low ] : 0;
+    }
+
+    void Prepare ( Definition* ddl, LinearAllocator* scratch );
+    void Write ( uint8_t* hot, uint8_t* cold ) const;
+  };
+
+  void
+  Packer::Prepare ( Definition* ddl, LinearAllocator* scratch )
+  {
+    m_Base = ( uint8_t* ) ddl;
+    m_TotalSize = ddl->m_TotalSize;
+    // Collect, sort and remove duplicated pointers, i.e. shared tags.
+    PointerCollector collector;
+    collector.m_Base = m_Base;
+    collector.m_Pointers.Init ( scratch );
+    collector.m_NumPointers = 0;
+    collector.AddDefinition ( ddl );
+    m_Pointers = ( RelPointer* ) scratch->SafeAllocate ( ( collector.m_NumPointers + 1 ) * sizeof ( RelPointer ), 4 );
+    GrowableArray< RelPointer >::Iterator it = collector.m_Pointers.Iterate();
+
+    for ( uint32_t i = 0; i < collector.m_NumPointers; i++ )
+    {
+      m_Pointers[ i ] = *it.Next();
+    }
+
+    qsort ( m_Pointers, collector.m_NumPointers, sizeof ( RelPointer ), CompareRelPointers );
+    m_NumPointers = 0;
+
+    for ( uint32_t i = 0; i < collector.m_NumPointers; i++ )
+    {
+      if ( m_NumPointers == 0 || m_Pointers[ m_NumPointers - 1 ].m_Offset != m_Pointers[ i ].m_Offset )
+      {
+        m_Pointers[ m_NumPointers++ ] = m_Pointers[ i ];
+      }
+    }
+
+    collector.m_Pointers.Destroy();
+    // Get the cold strings and everything pointed to by hot pointers.
+    m_Ranges = ( ColdRange* ) scratch->SafeAllocate ( ( m_NumPointers + 1 ) * sizeof ( ColdRange ), 4 );
+    uint32_t* hot_targets = ( uint32_t* ) scratch->SafeAllocate ( ( m_NumPointers + 1 ) * sizeof ( uint32_t ), 4 );
+    uint32_t num_hot_targets = 0;
+    m_NumRanges = 0;
+
+    for ( uint32_t i = 0; i < m_NumPointers; i++ )
+    {
+      uint32_t target = GetTarget ( &m_Pointers[ i ] );
+
+      if ( m_Pointers[ i ].m_Cold )
+      {
+        m_Ranges[ m_NumRanges ].m_Start = target;
+        m_Ranges[ m_NumRanges ].m_End = target + ( uint32_t ) strlen ( ( char* ) m_Base + target ) + 1;
+        m_NumRanges++;
+      }
+      else
+      {
+        hot_targets[ num_hot_targets++ ] = target;
+      }
+    }
+
+    qsort ( m_Ranges, m_NumRanges, sizeof ( ColdRange ), CompareColdRanges );
+    qsort ( hot_targets, num_hot_targets, sizeof ( uint32_t ), CompareOffsets );
+    // Merge overlapping strings, i.e. the same string used twice, and keep
+    // the ones that are also used by hot pointers.
+    uint32_t num_ranges = 0;
+    uint32_t next_hot = 0;
+
+    for ( uint32_t i = 0; i < m_NumRanges; i++ )
+    {
+      ColdRange range = m_Ranges[ i ];
+
+      if ( num_ranges != 0 && range.m_Start < m_Ranges[ num_ranges - 1 ].m_End )
+      {
+        ColdRange* last = &m_Ranges[ num_ranges - 1 ];
+        last->m_End = range.m_End > last->m_End ? range.m_End : last->m_End;
+        continue;
+      }
+
+      m_Ranges[ num_ranges++ ] = range;
+    }
+
+    m_NumRanges = 0;
+    m_ColdSize = 0;
+
+    for ( uint32_t i = 0; i < num_ranges; i++ )
+    {
+      ColdRange range = m_Ranges[ i ];
+
+      while ( next_hot < num_hot_targets && hot_targets[ next_hot ] < range.m_Start )
+      {
+        next_hot++;
+      }
+
+      if ( next_hot < num_hot_targets && hot_targets[ next_hot ] < range.m_End )
+      {
+        continue;
+      }
+
+      range.m_ColdOffset = m_ColdSize;
+      m_ColdSize += range.m_End - range.m_Start;
+      m_Ranges[ m_NumRanges++ ] = range;
+    }
+
+    // Remove contiguous runs of cold strings from the hot section.
+    m_Removals = ( Removal* ) scratch->SafeAllocate ( ( m_NumRanges + 1 ) * sizeof ( Removal ), 4 );
+    m_NumRemovals = 0;
+    uint32_t shift = 0;
+
+    for ( uint32_t i = 0; i < m_NumRanges; )
+    {
+      uint32_t start = m_Ranges[ i ].m_Start;
+      uint32_t end = m_Ranges[ i ].m_End;
+
+      for ( i++; i < m_NumRanges && m_Ranges[ i ].m_Start == end; i++ )
+      {
+        end = m_Ranges[ i ].m_End;
+      }
+
+      Removal* removal = &m_Removals[ m_NumRemovals++ ];
+      removal->m_Start = start;
+      removal->m_Size = ( end - start ) & ~7U;
+      removal->m_End = end;
+      removal->m_Shift = shift;
+      shift += removal->m_Size;
+    }
+
+    m_HotSize = m_TotalSize - shift;
+  }
+
+  void
+  Packer::Write ( uint8_t* hot, uint8_t* cold ) const
+  {
+    // Copy the hot bytes and clear the cold ones left in the hot section.
+    uint32_t offset = 0;
+
+    for ( uint32_t i = 0; i < m_NumRemovals; i++ )
+    {
+      const Removal* removal = &m_Removals[ i ];
+      memcpy ( hot + offset - m_Removals[ i ].m_Shift, m_Base + offset, removal->m_Start - offset );
+      memset ( hot + removal->m_Start - removal->m_Shift, 0, removal->m_End - removal->m_Start - removal->m_Size );
+      offset = removal->m_End;
+    }
+
+    memcpy ( hot + Map ( offset ), m_Base + offset, m_TotalSize - offset );
+
+    // Move the cold strings.
+    for ( uint32_t i = 0; i < m_NumRanges; i++ )
+    {
+      memcpy ( cold + m_Ranges[ i ].m_ColdOffset, m_Base + m_Ranges[ i ].m_Start, m_Ranges[ i ].m_End - m_Ranges[ i ].m_Start );
+    }
+
+    // Fix the pointers. The cold section follows the hot one.
+    for ( uint32_t i = 0; i < m_NumPointers; i++ )
+    {
+      uint32_t target = GetTarget ( &m_Pointers[ i ] );
+      const ColdRange* range = FindRange ( target );
+      uint32_t new_offset = Map ( m_Pointers[ i ].m_Offset );
+      uint32_t new_target = range != 0 ? m_HotSize + range->m_ColdOffset + target - range->m_Start : Map ( target );
+      * ( Offset* ) ( hot + new_offset ) = ( Offset ) ( new_target - new_offset );
+    }
+
+    ( ( Definition* ) hot )->m_TotalSize = m_HotSize + m_ColdSize;
+  }
+
+  const ContainerSection*
+  ContainerHeader::FindSection ( uint32_t type ) const
+  {
+    for ( uint32_t i = 0; i < m_NumSections; i++ )
+    {
+      if ( m_Sections[ i ].m_Type == type )
+      {
+        return &m_Sections[ i ];
+      }
+    }
+
+    return 0;
+  }
+
+  size_t
+  WriteContainer ( Definition* ddl, LinearAllocator* scratch, uint32_t options, uint32_t source_hash, void* buffer, size_t buffer_size )
+  {
+    try
+    {
+      Packer packer;
+      packer.Prepare ( ddl, scratch );
+      uint32_t header_size = sizeof ( ContainerHeader ) + 2 * sizeof ( ContainerSection );
+      uint32_t hot_offset = AlignUp ( header_size, 8 );
+      uint32_t cold_offset = hot_offset + packer.m_HotSize;
+      size_t total_size = cold_offset + packer.m_ColdSize;
+
+      if ( total_size > buffer_size )
+      {
+        return total_size;
+      }
+
+      ContainerHeader* header = ( ContainerHeader* ) buffer;
+      uint8_t* hot = ( uint8_t* ) buffer + hot_offset;
+      uint8_t* cold = ( uint8_t* ) buffer + cold_offset;
+      memset ( header, 0, hot_offset );
+      packer.Write ( hot, cold );
+      header->m_Magic = kContainerMagic;
+      header->m_Version = kContainerVersion;
+      header->m_Size = header_size;
+      header->m_Options = options;
+      header->m_SourceHash = source_hash;
+      header->m_DefinitionSize = packer.m_HotSize + packer.m_ColdSize;
+      header->m_NumSections = 2;
+      header->m_Sections[ 0 ].m_Type = kSectionHot;
+      header->m_Sections[ 0 ].m_Offset = hot_offset;
+      header->m_Sections[ 0 ].m_Size = packer.m_HotSize;
+      header->m_Sections[ 0 ].m_Crc = Crc32 ( hot, ( int ) packer.m_HotSize );
+      header->m_Sections[ 1 ].m_Type = kSectionCold;
+      header->m_Sections[ 1 ].m_Offset = cold_offset;
+      header->m_Sections[ 1 ].m_Size = packer.m_ColdSize;
+      header->m_Sections[ 1 ].m_Crc = Crc32 ( cold, ( int ) packer.m_ColdSize );
+      return total_size;
+    }
+    catch ( const char* )
+    {
+      // Out of memory.
+      return 0;
+    }
+  }
+
+  const ContainerHeader*
+  ReadContainerHeader ( const void* data, size_t size )
+  {
+    const ContainerHeader* header = ( const ContainerHeader* ) data;
+
+    if ( size < sizeof ( ContainerHeader ) || header->m_Magic != kContainerMagic || header->m_Version != kContainerVersion )
+    {
+      return 0;
+    }
+
+    if ( header->m_Size > size || header->m_Size < sizeof ( ContainerHeader ) + header->m_NumSections * sizeof ( ContainerSection ) )
+    {
+      return 0;
+    }
+
+    return header;
+  }
+
+  Definition*
+  LoadHotSection ( const ContainerHeader* header, const void* hot, void* memory )
+  {
+    const ContainerSection* section = header->FindSection ( kSectionHot );
+
+    if ( section == 0 || section->m_Size > header->m_DefinitionSize || Crc32 ( hot, ( int ) section->m_Size ) != section->m_Crc )
+    {
+      return 0;
+    }
+
+    memcpy ( memory, hot, section->m_Size );
+    memset ( ( uint8_t* ) memory + section->m_Size, 0, header->m_DefinitionSize - section->m_Size );
+    return Definition::FromBinRep ( memory );
+  }
+
+  bool
+  LoadColdSection ( const ContainerHeader* header, const void* cold, Definition* ddl )
+  {
+    const ContainerSection* hot_section = header->FindSection ( kSectionHot );
+    const ContainerSection* section = header->FindSection ( kSectionCold );
+
+    if ( hot_section == 0 || section == 0 || hot_section->m_Size + section->m_Size > header->m_DefinitionSize )
+    {
+      return false;
+    }
+
+    if ( Crc32 ( cold, ( int ) section->m_Size ) != section->m_Crc )
+    {
+      return false;
+    }
+
+    memcpy ( ( uint8_t* ) ddl + hot_section->m_Size, cold, section->m_Size );
+    return true;
+  }
+};
@@ -3,6 +3,8 @@
 #include <DDLParser.h>
 
 #include "Parser.h"
+#include "Layout.h"
+#include "Diff.h"
 
 #define IMP_POINTER(name, type)                               \
   type* name::operator->() const                              \
@@ -57,6 +59,7 @@ namespace DDLParser
   IMP_POINTER ( StructUnknownValuePtr,  StructUnknownValue );
   IMP_POINTER ( StructFieldPtr,         StructField );
   IMP_POINTER ( StructFieldRangePtr,    StructFieldRange );
+  IMP_POINTER ( DefaultImageFixupPtr,   DefaultImageFixup );
 
 #define ASSERT( x )
 #define OFFSET_OF(s, m) (((size_t)&(((s *)0x10)->m))-0x10)
@@ -349,6 +352,112 @@ namespace DDLParser
     return &values[ index ];
   }
 
+  uint32_t
+  DefaultImageFixup::GetOffset() const
+  {
+    return m_Offset;
+  }
+
+  const char*
+  DefaultImageFixup::GetValue() const
+  {
+    return &*m_Value;
+  }
+
+  uint32_t
+  DefaultImage::GetInstanceSize() const
+  {
+    if ( CHECK_OFFSET ( DefaultImage, m_InstanceSize, m_Size ) )
+    {
+      return m_InstanceSize;
+    }
+
+    return 0;
+  }
+
+  uint32_t
+  DefaultImage::GetAlignment() const
+  {
+    if ( CHECK_OFFSET ( DefaultImage, m_Alignment, m_Size ) )
+    {
+      return m_Alignment;
+    }
+
+    return 1;
+  }
+
+  const void*
+  DefaultImage::GetImage() const
+  {
+    if ( CHECK_OFFSET ( DefaultImage, m_Image, m_Size ) )
+    {
+      return &*m_Image;
+    }
+
+    return 0;
+  }
+
+  uint32_t
+  DefaultImage::GetNumFixups() const
+  {
+    if ( CHECK_OFFSET ( DefaultImage, m_NumFixups, m_Size ) )
+    {
+      return m_NumFixups;
+    }
+
+    return 0;
+  }
+
+  const DefaultImageFixup*
+  DefaultImage::GetFixup ( uint32_t index ) const
+  {
+    ASSERT ( index < GetNumFixups() );
+    return &m_Fixups.Get() [ index ];
+  }
+
+  uint32_t
+  DefaultImage::GetNumFields() const
+  {
+    if ( CHECK_OFFSET ( DefaultImage, m_NumFields, m_Size ) )
+    {
+      return m_NumFields;
+    }
+
+    return 0;
+  }
+
+  uint32_t
+  DefaultImage::GetFieldOffset ( uint32_t index ) const
+  {
+    ASSERT ( index < GetNumFields() );
+    uint32_t* offsets = ( uint32_t* ) ( ( uint8_t* ) this + m_Size );
+    return offsets[ index ];
+  }
+
+  void
+  DefaultImage::Instantiate ( void* instance ) const
+  {
+    memcpy ( instance, GetImage(), GetInstanceSize() );
+    uint32_t num_fixups = GetNumFixups();
+
+    for ( uint32_t i = 0; i < num_fixups; i++ )
+    {
+      const DefaultImageFixup* fixup = GetFixup ( i );
+      * ( const char** ) ( ( uint8_t* ) instance + fixup->GetOffset() ) = fixup->GetValue();
+    }
+  }
+
+  uint32_t
+  ContentHash::GetHash() const
+  {
+    if ( CHECK_OFFSET ( ContentHash, m_Hash, m_Size ) )
+    {
+      return m_Hash;
+    }
+
+    return 0;
+  }
+
   static Tag*
   FindTag ( Tag* tag, uint32_t type )
   {
@@ -452,6 +561,27 @@ namespace DDLParser
     return 0;
   }
 
+  uint32_t
+  Aggregate::GetContentHash() const
+  {
+    Tag* tag = 0;
+
+    switch ( GetType() )
+    {
+      case kSelect:
+        tag = ToSelect()->GetTag ( kContentHash );
+        break;
+      case kBitfield:
+        tag = ToBitfield()->GetTag ( kContentHash );
+        break;
+      case kStruct:
+        tag = ToStruct()->GetTag ( kContentHash );
+        break;
+    }
+
+    return tag != 0 ? ( ( ContentHash* ) tag )->GetHash() : 0;
+  }
+
   Select*
   Aggregate::ToSelect() const
   {
@@ -1070,6 +1200,12 @@ namespace DDLParser
     return crc;
   }
 
+  DefaultImage*
+  Struct::GetDefaultImage() const
+  {
+    return ( DefaultImage* ) GetTag ( kDefaultImage );
+  }
+
   uint32_t
   Definition::GetNumAggregates() const
   {
@@ -1136,10 +1272,20 @@ namespace DDLParser
     return 0;
   }
 
-  Definition* Compile ( LinearAllocator* definition, LinearAllocator* scratch, const void* source, size_t source_size, char* error, size_t error_size, bool two_us_reserved, int bitfield_limit )
+  Definition* Compile ( LinearAllocator* definition, LinearAllocator* scratch, const void* source, size_t source_size, char* error, size_t error_size, bool two_us_reserved, int bitfield_limit, uint32_t options )
   {
     bool ok = Parser::Parse ( definition, scratch, source, ( uint32_t ) source_size, error, ( uint32_t ) error_size, two_us_reserved, bitfield_limit );
 
+    if ( ok && ( options & kCompileDefaultImages ) != 0 )
+    {
+      ok = BuildDefaultImages ( definition, scratch, error, ( uint32_t ) error_size );
+    }
+
+    if ( ok && ( options & kCompileContentHashes ) != 0 )
+    {
+      ok = BuildContentHashes ( definition, error, ( uint32_t ) error_size );
+    }
+
     if ( ok )
     {
       return Definition::FromBinRep ( definition->GetBase() );
@@ -0,0 +1,540 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include <DDLParser.h>
+
+#include "Layout.h"
+#include "Diff.h"
+#include "Error.h"
+
+namespace DDLParser
+{
+  // Hashes NULL strings differently from empty ones.
+  static const uint32_t kNullMarker = 0xffffffffU;
+
+  struct ContentHasher
+  {
+    Definition* m_Definition;
+    uint32_t    m_Crc;
+
+    void AddBytes ( const void* data, uint32_t size )
+    {
+      m_Crc = Crc32WithSeed ( data, ( int ) size, m_Crc );
+    }
+
+    void AddUint32 ( uint32_t value )
+    {
+      AddBytes ( &value, sizeof ( value ) );
+    }
+
+    void AddString ( const char* str )
+    {
+      if ( str == 0 )
+      {
+        AddUint32 ( kNullMarker );
+      }
+      else
+      {
+        AddBytes ( str, ( uint32_t ) strlen ( str ) + 1 );
+      }
+    }
+
+    void AddInfo ( const BasicInfo* info )
+    {
+      AddString ( info->GetName() );
+      AddString ( info->GetAuthor() );
+      AddString ( info->GetDescription() );
+      AddString ( info->GetLabel() );
+    }
+
+    void AddAggregate ( const Aggregate* aggregate )
+    {
+      AddUint32 ( aggregate->GetType() );
+      AddUint32 ( aggregate->GetNameHash() );
+      AddString ( aggregate->GetName() );
+      AddString ( aggregate->GetAuthor() );
+      AddString ( aggregate->GetDescription() );
+      AddString ( aggregate->GetLabel() );
+    }
+
+    void AddUsedAggregate ( uint32_t type, uint32_t type_name_hash )
+    {
+      if ( type == kSelect || type == kBitfield || type == kStruct )
+      {
+        Aggregate* aggregate = m_Definition->FindAggregate ( type_name_hash );
+        AddUint32 ( aggregate != 0 ? aggregate->GetContentHash() : kNullMarker );
+      }
+    }
+
+    void AddTags ( Tag* tag, uint32_t type );
+    void AddValue ( const StructValueInfo* info );
+    void AddValueInfo ( const StructValueInfo* info );
+    void AddSelect ( Select* select );
+    void AddBitfield ( Bitfield* bitfield );
+    void AddStruct ( Struct* structure );
+  };
+
+  void
+  ContentHasher::AddTags ( Tag* tag, uint32_t type )
+  {
+    for ( ; tag != 0; tag = tag->GetNext() )
+    {
+      if ( tag->GetType() == kDefaultImage || tag->GetType() == kContentHash )
+      {
+        // Derived from the rest of the definition.
+        continue;
+      }
+
+      AddUint32 ( tag->GetType() );
+
+      switch ( tag->GetType() )
+      {
+        case kExtensions:
+        {
+          Extensions* extensions = ( Extensions* ) tag;
+          AddUint32 ( extensions->GetCount() );
+
+          for ( uint32_t i = 0; i < extensions->GetCount(); i++ )
+          {
+            AddString ( extensions->GetExtension ( i ) );
+          }
+        }
+        break;
+        case kVaultHints:
+        {
+          VaultHints* hints = ( VaultHints* ) tag;
+          AddUint32 ( hints->GetCount() );
+
+          for ( uint32_t i = 0; i < hints->GetCount(); i++ )
+          {
+            AddString ( hints->GetVaultHint ( i ) );
+          }
+        }
+        break;
+        case kUIRange:
+        {
+          UIRange* range = ( UIRange* ) tag;
+
+          // Only the bytes of the field's type are set in the range values.
+          if ( type <= kFloat64 )
+          {
+            uint32_t size = GetTypeLayout ( m_Definition, type, 0 ).m_Size;
+            AddBytes ( range->GetSoftMin(), size );
+            AddBytes ( range->GetSoftMax(), size );
+            AddBytes ( range->GetHardMin(), size );
+            AddBytes ( range->GetHardMax(), size );
+            AddBytes ( range->GetStep(), size );
+          }
+        }
+        break;
+        case kUIRender:
+          AddString ( ( ( UIRender* ) tag )->GetRender() );
+          break;
+        case kParallel:
+          AddUint32 ( ( ( Parallel* ) tag )->GetArray()->GetValueInfo()->GetNameHash() );
+          break;
+        case kVersion:
+          AddString ( ( ( Version* ) tag )->GetVersion() );
+          break;
+        case kCallback:
+          AddString ( ( ( Callback* ) tag )->GetCallback() );
+          break;
+        case kKey:
+          AddString ( ( ( Key* ) tag )->GetKey() );
+          break;
+        case kUnits:
+          AddString ( ( ( Units* ) tag )->GetUnits() );
+          break;
+        case kGeneric:
+        {
+          GenericTag* generic = ( GenericTag* ) tag;
+          AddString ( generic->GetName() );
+          AddUint32 ( generic->GetNumValues() );
+
+          for ( uint32_t i = 0; i < generic->GetNumValues(); i++ )
+          {
+            GenericTagValue* value = ( *generic ) [ i ];
+            AddUint32 ( value->m_Type );
+
+            if ( value->m_Type == kString )
+            {
+              AddString ( &*value->m_String );
+            }
+            else
+            {
+              // kInt64 and kFloat64.
+              AddBytes ( &value->m_Int64, sizeof ( value->m_Int64 ) );
+            }
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  void
+  ContentHasher::AddValue ( const StructValueInfo* info )
+  {
+    StructFieldValue* value = info->GetValue();
+
+    if ( value == 0 )
+    {
+      AddUint32 ( kNullMarker );
+      return;
+    }
+
+    uint32_t count = info->GetCount();
+
+    switch ( info->GetType() )
+    {
+      case kUint8:
+      case kInt8:
+      case kBoolean:
+      case kUint16:
+      case kInt16:
+      case kUint32:
+      case kInt32:
+      case kUint64:
+      case kInt64:
+      case kTuid:
+      case kFloat32:
+      case kFloat64:
+        AddBytes ( value->m_Uint8, count * GetTypeLayout ( m_Definition, info->GetType(), 0 ).m_Size );
+        break;
+      case kString:
+      case kFile:
+      case kJson:
+        for ( uint32_t i = 0; i < count; i++ )
+        {
+          AddString ( &*value->m_String[ i ] );
+        }
+
+        break;
+      case kSelect:
+        AddBytes ( value->m_Select, count * sizeof ( uint32_t ) );
+        break;
+      case kBitfield:
+        for ( uint32_t i = 0; i < count; i++ )
+        {
+          StructBitfieldValue* flags = &*value->m_Bitfield[ i ];
+          AddUint32 ( flags->GetCount() );
+
+          for ( uint32_t j = 0; j < flags->GetCount(); j++ )
+          {
+            AddUint32 ( flags->GetHash ( j ) );
+          }
+        }
+
+        break;
+      case kStruct:
+        for ( uint32_t i = 0; i < count; i++ )
+        {
+          StructStructValue* fields = &*value->m_Struct[ i ];
+          AddUint32 ( fields->GetCount() );
+
+          for ( uint32_t j = 0; j < fields->GetCount(); j++ )
+          {
+            AddValueInfo ( fields->GetValueInfo ( j ) );
+          }
+        }
+
+        break;
+      case kUnknown:
+        for ( uint32_t i = 0; i < count; i++ )
+        {
+          StructUnknownValue* ids = &*value->m_Unknown[ i ];
+          AddUint32 ( ids->GetCount() );
+
+          for ( uint32_t j = 0; j < ids->GetCount(); j++ )
+          {
+            AddString ( ids->GetId ( j ) );
+          }
+        }
+
+        break;
+      default:
+        break;
+    }
+  }
+
+  void
+  ContentHasher::AddValueInfo ( const StructValueInfo* info )
+  {
+    AddUint32 ( info->GetNameHash() );
+    AddUint32 ( info->GetType() );
+
+    if ( info->GetType() == kUnknown )
+    {
+      AddString ( info->GetTypeName() );
+    }
+    else
+    {
+      AddUint32 ( info->GetTypeNameHash() );
+      AddUsedAggregate ( info->GetType(), info->GetTypeNameHash() );
+    }
+
+    AddUint32 ( info->GetArrayType() );
+    AddUint32 ( info->m_Count );
+    AddUint32 ( info->GetKeyType() );
+    AddValue ( info );
+    AddTags ( info->GetTags(), info->GetType() );
+  }
+
+  void
+  ContentHasher::AddSelect ( Select* select )
+  {
+    AddUint32 ( select->GetNumItems() );
+    AddUint32 ( ( uint32_t ) select->GetDefaultItem() );
+
+    for ( uint32_t i = 0; i < select->GetNumItems(); i++ )
+    {
+      SelectItem* item = ( *select ) [ i ];
+      AddInfo ( item );
+      AddUint32 ( item->GetNameHash() );
+      AddTags ( item->GetTags(), kTypeMax );
+    }
+
+    AddTags ( select->GetTags(), kTypeMax );
+  }
+
+  void
+  ContentHasher::AddBitfield ( Bitfield* bitfield )
+  {
+    AddUint32 ( bitfield->GetNumFlags() );
+    AddUint32 ( ( uint32_t ) bitfield->GetDefaultFlag() );
+
+    for ( uint32_t i = 0; i < bitfield->GetNumFlags(); i++ )
+    {
+      BitfieldFlag* flag = ( *bitfield ) [ i ];
+      BitfieldFlagValue* value = flag->GetValue();
+      AddInfo ( flag );
+      AddUint32 ( flag->GetNameHash() );
+      AddUint32 ( flag->GetBit() );
+      AddUint32 ( value != 0 ? value->GetCount() : kNullMarker );
+
+      for ( uint32_t j = 0; value != 0 && j < value->GetCount(); j++ )
+      {
+        AddUint32 ( value->GetFlagIndex ( j ) );
+      }
+
+      AddTags ( flag->GetTags(), kTypeMax );
+    }
+
+    AddTags ( bitfield->GetTags(), kTypeMax );
+  }
+
+  void
+  ContentHasher::AddStruct ( Struct* structure )
+  {
+    Struct* parent = structure->GetParent();
+
+    if ( parent != 0 )
+    {
+      AddUint32 ( parent->GetNameHash() );
+      AddUint32 ( parent->GetContentHash() );
+    }
+    else
+    {
+      AddUint32 ( kNullMarker );
+    }
+
+    // The fields include the inherited ones.
+    AddUint32 ( structure->GetNumFields() );
+
+    for ( uint32_t i = 0; i < structure->GetNumFields(); i++ )
+    {
+      StructField* field = ( *structure ) [ i ];
+      AddInfo ( field );
+      AddValueInfo ( field->GetValueInfo() );
+    }
+
+    AddTags ( structure->GetTags(), kTypeMax );
+  }
+
+  static TagPtr*
+  GetTagList ( Aggregate* aggregate )
+  {
+    switch ( aggregate->GetType() )
+    {
+      case kSelect:
+        return &aggregate->ToSelect()->m_Tags;
+      case kBitfield:
+        return &aggregate->ToBitfield()->m_Tags;
+      default:
+        return &aggregate->ToStruct()->m_Tags;
+    }
+  }
+
+  uint32_t
+  ComputeContentHash ( Definition* ddl, Aggregate* aggregate )
+  {
+    ContentHasher hasher;
+    hasher.m_Definition = ddl;
+    hasher.m_Crc = kCrcSeedDefaultU32;
+    hasher.AddAggregate ( aggregate );
+
+    switch ( aggregate->GetType() )
+    {
+      case kSelect:
+        hasher.AddSelect ( aggregate->ToSelect() );
+        break;
+      case kBitfield:
+        hasher.AddBitfield ( aggregate->ToBitfield() );
+        break;
+      case kStruct:
+        hasher.AddStruct ( aggregate->ToStruct() );
+        break;
+    }
+
+    // Zero means no hash.
+    return hasher.m_Crc != 0 ? hasher.m_Crc : 1;
+  }
+
+  bool
+  BuildContentHashes ( LinearAllocator* definition, char* error, uint32_t error_size )
+  {
+    try
+    {
+      Definition* ddl = Definition::FromBinRep ( definition->GetBase() );
+
+      // Aggregates are always defined before being used, so the hashes of
+      // the aggregates used by fields are already set.
+      for ( uint32_t i = 0; i < ddl->GetNumAggregates(); i++ )
+      {
+        Aggregate* aggregate = ddl->GetAggregate ( i );
+
+        if ( aggregate->GetContentHash() != 0 )
+        {
+          continue;
+        }
+
+        ContentHash* tag = ( ContentHash* ) definition->SafeAllocate ( sizeof ( ContentHash ), 4 );
+        tag->m_Size = sizeof ( ContentHash );
+        tag->m_Type = kContentHash;
+        tag->m_Hash = ComputeContentHash ( ddl, aggregate );
+        // Link the tag.
+        TagPtr* tags = GetTagList ( aggregate );
+        tag->m_Next = tags->Get();
+        *tags = tag;
+      }
+
+      ddl->m_TotalSize = ( uint32_t ) definition->GetCurrentOffset();
+      return true;
+    }
+    catch ( const char* the_error )
+    {
+      return ErrorThrown ( error, error_size, the_error );
+    }
+  }
+
+  bool
+  CheckContentHashes ( Definition* ddl )
+  {
+    for ( uint32_t i = 0; i < ddl->GetNumAggregates(); i++ )
+    {
+      Aggregate* aggregate = ddl->GetAggregate ( i );
+
+      if ( aggregate->GetContentHash() == 0 || aggregate->GetContentHash() != ComputeContentHash ( ddl, aggregate ) )
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  struct DiffEntry
+  {
+    uint32_t   m_NameHash;
+    Aggregate* m_Aggregate;
+  };
+
+  static int
+  CompareEntries ( const void* a, const void* b )
+  {
+    uint32_t hash_a = ( ( const DiffEntry* ) a )->m_NameHash;
+    uint32_t hash_b = ( ( const DiffEntry* ) b )->m_NameHash;
+    return hash_a < hash_b ? -1 : hash_a > hash_b ? 1 : 0;
+  }
+
+  static DiffEntry*
+  SortAggregates ( Definition* ddl, LinearAllocator* scratch )
+  {
+    uint32_t count = ddl->GetNumAggregates();
+    // One more so empty definitions don't allocate zero bytes.
+    DiffEntry* entries = ( DiffEntry* ) scratch->Allocate ( ( count + 1 ) * sizeof ( DiffEntry ), sizeof ( void* ) );
+
+    if ( entries != 0 )
+    {
+      for ( uint32_t i = 0; i < count; i++ )
+      {
+        entries[ i ].m_Aggregate = ddl->GetAggregate ( i );
+        entries[ i ].m_NameHash = entries[ i ].m_Aggregate->GetNameHash();
+      }
+
+      qsort ( entries, count, sizeof ( DiffEntry ), CompareEntries );
+    }
+
+    return entries;
+  }
+
+  static void
+  AddDiff ( DefinitionDiff* diffs, uint32_t max_diffs, int32_t* num_diffs, uint32_t type, uint32_t name_hash, Aggregate* old_aggregate, Aggregate* new_aggregate )
+  {
+    if ( ( uint32_t ) *num_diffs < max_diffs )
+    {
+      DefinitionDiff* diff = diffs + *num_diffs;
+      diff->m_Type = type;
+      diff->m_NameHash = name_hash;
+      diff->m_Old = old_aggregate;
+      diff->m_New = new_aggregate;
+    }
+
+    ++*num_diffs;
+  }
+
+  int32_t
+  DiffDefinitions ( Definition* old_ddl, Definition* new_ddl, LinearAllocator* scratch, DefinitionDiff* diffs, uint32_t max_diffs )
+  {
+    DiffEntry* old_entries = SortAggregates ( old_ddl, scratch );
+    DiffEntry* new_entries = SortAggregates ( new_ddl, scratch );
+
+    if ( old_entries == 0 || new_entries == 0 )
+    {
+      return -1;
+    }
+
+    uint32_t old_count = old_ddl->GetNumAggregates();
+    uint32_t new_count = new_ddl->GetNumAggregates();
+    uint32_t i = 0, j = 0;
+    int32_t num_diffs = 0;
+
+    // Merge the two sorted lists.
+    while ( i < old_count || j < new_count )
+    {
+      if ( j == new_count || ( i < old_count && old_entries[ i ].m_NameHash < new_entries[ j ].m_NameHash ) )
+      {
+        AddDiff ( diffs, max_diffs, &num_diffs, kDiffRemoved, old_entries[ i ].m_NameHash, old_entries[ i ].m_Aggregate, 0 );
+        i++;
+      }
+      else if ( i == old_count || new_entries[ j ].m_NameHash < old_entries[ i ].m_NameHash )
+      {
+        AddDiff ( diffs, max_diffs, &num_diffs, kDiffAdded, new_entries[ j ].m_NameHash, 0, new_entries[ j ].m_Aggregate );
+        j++;
+      }
+      else
+      {
+        Aggregate* old_aggregate = old_entries[ i++ ].m_Aggregate;
+        Aggregate* new_aggregate = new_entries[ j++ ].m_Aggregate;
+
+        // Definitions without content hashes always differ.
+        if ( old_aggregate->GetContentHash() != new_aggregate->GetContentHash() || old_aggregate->GetContentHash() == 0 )
+        {
+          AddDiff ( diffs, max_diffs, &num_diffs, kDiffChanged, old_aggregate->GetNameHash(), old_aggregate, new_aggregate );
+        }
+      }
+    }
+
+    return num_diffs;
+  }
+};
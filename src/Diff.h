@@ -0,0 +1,14 @@
+#pragma once
+
+#include <DDLParser.h>
+
+namespace DDLParser
+{
+  // Computes the content hash of an aggregate. The aggregates used by its
+  // fields must already have their ContentHash tags.
+  uint32_t ComputeContentHash ( Definition* ddl, Aggregate* aggregate );
+
+  // Adds a ContentHash tag to the aggregates in the definition that don't
+  // have one yet, and updates its total size.
+  bool BuildContentHashes ( LinearAllocator* definition, char* error, uint32_t error_size );
+};
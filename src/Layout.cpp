@@ -0,0 +1,411 @@
+#include <string.h>
+#include <stddef.h>
+
+#include <DDLParser.h>
+
+#include "Layout.h"
+#include "Error.h"
+#include "GrowableArray.h"
+
+namespace DDLParser
+{
+  template< typename T > static inline uint32_t
+  AlignmentOf()
+  {
+    struct _
+    {
+      char c;
+      T    x;
+    };
+
+    return ( uint32_t ) offsetof ( _, x );
+  }
+
+  static NativeLayout
+  MakeLayout ( uint32_t size, uint32_t alignment )
+  {
+    NativeLayout layout;
+    layout.m_Size = size;
+    layout.m_Alignment = alignment;
+    layout.m_NumFields = 0;
+    return layout;
+  }
+
+  NativeLayout
+  GetTypeLayout ( Definition* ddl, uint32_t type, uint32_t type_name_hash )
+  {
+    switch ( type )
+    {
+      case kUint8:
+      case kInt8:
+      case kBoolean:
+        return MakeLayout ( sizeof ( uint8_t ), AlignmentOf< uint8_t >() );
+      case kUint16:
+      case kInt16:
+        return MakeLayout ( sizeof ( uint16_t ), AlignmentOf< uint16_t >() );
+      case kUint32:
+      case kInt32:
+      case kSelect:
+      case kBitfield:
+        return MakeLayout ( sizeof ( uint32_t ), AlignmentOf< uint32_t >() );
+      case kUint64:
+      case kInt64:
+      case kTuid:
+        return MakeLayout ( sizeof ( uint64_t ), AlignmentOf< uint64_t >() );
+      case kFloat32:
+        return MakeLayout ( sizeof ( float ), AlignmentOf< float >() );
+      case kFloat64:
+        return MakeLayout ( sizeof ( double ), AlignmentOf< double >() );
+      case kStruct:
+        return GetNativeLayout ( ddl, ddl->FindAggregate ( type_name_hash )->ToStruct() );
+    }
+
+    // kString, kFile, kJson and kUnknown.
+    return MakeLayout ( sizeof ( const char* ), AlignmentOf< const char* >() );
+  }
+
+  NativeLayout
+  GetNativeLayout ( Definition* ddl, const StructValueInfo* info )
+  {
+    NativeLayout value = GetTypeLayout ( ddl, info->GetType(), info->GetTypeNameHash() );
+
+    if ( info->GetArrayType() != kHashmap )
+    {
+      return value;
+    }
+
+    // The key comes first, then the value.
+    NativeLayout pair = GetTypeLayout ( ddl, info->GetKeyType(), 0 );
+    pair.m_Size = AlignUp ( pair.m_Size, value.m_Alignment ) + value.m_Size;
+    pair.m_Alignment = pair.m_Alignment > value.m_Alignment ? pair.m_Alignment : value.m_Alignment;
+    pair.m_Size = AlignUp ( pair.m_Size, pair.m_Alignment );
+    pair.m_NumFields = 2;
+    return pair;
+  }
+
+  NativeLayout
+  GetNativeLayout ( Definition* ddl, Struct* structure, uint32_t* offsets )
+  {
+    // Inherited fields come first.
+    NativeLayout layout = MakeLayout ( 0, 1 );
+    uint32_t num_fields = structure->GetNumFields();
+
+    for ( uint32_t i = 0; i < num_fields; i++ )
+    {
+      const StructValueInfo* info = ( *structure ) [ i ]->GetValueInfo();
+      NativeLayout field;
+
+      switch ( info->GetArrayType() )
+      {
+        case kScalar:
+          field = GetNativeLayout ( ddl, info );
+          break;
+        case kFixed:
+          field = GetNativeLayout ( ddl, info );
+          field.m_Size *= info->GetCount();
+          break;
+        default:
+          field = MakeLayout ( sizeof ( NativeArray ), AlignmentOf< NativeArray >() );
+          break;
+      }
+
+      layout.m_Size = AlignUp ( layout.m_Size, field.m_Alignment );
+
+      if ( offsets != 0 )
+      {
+        *offsets++ = layout.m_Size;
+      }
+
+      layout.m_Size += field.m_Size;
+      layout.m_Alignment = layout.m_Alignment > field.m_Alignment ? layout.m_Alignment : field.m_Alignment;
+      layout.m_NumFields++;
+    }
+
+    layout.m_Size = AlignUp ( layout.m_Size, layout.m_Alignment );
+    return layout;
+  }
+
+  struct PendingFixup
+  {
+    uint32_t    m_Offset;
+    const char* m_Value;
+  };
+
+  struct ImageBuilder
+  {
+    Definition*                   m_Definition;
+    uint8_t*                      m_Image;
+    GrowableArray< PendingFixup > m_Fixups;
+    uint32_t                      m_NumFixups;
+    const char*                   m_EmptyString;
+
+    void AddFixup ( uint32_t offset, const char* value )
+    {
+      // Values in structure values override the defaults already written.
+      GrowableArray< PendingFixup >::Iterator it = m_Fixups.Iterate();
+      PendingFixup* fixup;
+
+      while ( ( fixup = it.Next() ) != 0 )
+      {
+        if ( fixup->m_Offset == offset )
+        {
+          fixup->m_Value = value;
+          return;
+        }
+      }
+
+      fixup = m_Fixups.Append();
+      fixup->m_Offset = offset;
+      fixup->m_Value = value;
+      m_NumFixups++;
+    }
+
+    void WriteStruct ( Struct* structure, uint32_t offset );
+    void WriteStructValue ( Struct* structure, const StructStructValue* value, uint32_t offset );
+    void WriteField ( const StructValueInfo* info, uint32_t offset, bool defaults );
+  };
+
+  static uint32_t
+  GetFlagValue ( Bitfield* bitfield, BitfieldFlag* flag )
+  {
+    if ( flag->GetBit() != 0 )
+    {
+      return 1U << ( flag->GetBit() - 1 );
+    }
+
+    BitfieldFlagValue* value = flag->GetValue();
+    uint32_t result = 0;
+
+    for ( uint32_t i = 0; value != 0 && i < value->GetCount(); i++ )
+    {
+      result |= GetFlagValue ( bitfield, ( *bitfield ) [ value->GetFlagIndex ( i ) ] );
+    }
+
+    return result;
+  }
+
+  void
+  ImageBuilder::WriteStruct ( Struct* structure, uint32_t offset )
+  {
+    // Structures are always defined before being used as field types, so
+    // their images are already built.
+    const DefaultImage* image = structure->GetDefaultImage();
+    memcpy ( m_Image + offset, image->GetImage(), image->GetInstanceSize() );
+
+    for ( uint32_t i = 0; i < image->GetNumFixups(); i++ )
+    {
+      const DefaultImageFixup* fixup = image->GetFixup ( i );
+      AddFixup ( offset + fixup->GetOffset(), fixup->GetValue() );
+    }
+  }
+
+  void
+  ImageBuilder::WriteStructValue ( Struct* structure, const StructStructValue* value, uint32_t offset )
+  {
+    const DefaultImage* image = structure->GetDefaultImage();
+
+    for ( uint32_t i = 0; i < value->GetCount(); i++ )
+    {
+      const StructValueInfo* info = value->GetValueInfo ( i );
+
+      for ( uint32_t j = 0; j < structure->GetNumFields(); j++ )
+      {
+        if ( ( *structure ) [ j ]->GetValueInfo()->GetNameHash() == info->GetNameHash() )
+        {
+          WriteField ( info, offset + image->GetFieldOffset ( j ), false );
+          break;
+        }
+      }
+    }
+  }
+
+  void
+  ImageBuilder::WriteField ( const StructValueInfo* info, uint32_t offset, bool defaults )
+  {
+    if ( info->GetArrayType() == kDynamic || info->GetArrayType() == kHashmap )
+    {
+      // Empty NativeArray.
+      return;
+    }
+
+    NativeLayout element = GetNativeLayout ( m_Definition, info );
+    StructFieldValue* value = info->GetValue();
+    uint32_t count = info->GetCount();
+
+    for ( uint32_t i = 0; i < count; i++, offset += element.m_Size )
+    {
+      uint8_t* dest = m_Image + offset;
+
+      switch ( info->GetType() )
+      {
+        case kUint8:
+        case kInt8:
+        case kBoolean:
+        case kUint16:
+        case kInt16:
+        case kUint32:
+        case kInt32:
+        case kUint64:
+        case kInt64:
+        case kTuid:
+        case kFloat32:
+        case kFloat64:
+          if ( value != 0 )
+          {
+            // Native values are stored with their natural sizes.
+            memcpy ( dest, value->m_Uint8 + i * element.m_Size, element.m_Size );
+          }
+
+          break;
+        case kString:
+        case kFile:
+        case kJson:
+          if ( value != 0 )
+          {
+            AddFixup ( offset, &*value->m_String[ i ] );
+          }
+          else if ( defaults )
+          {
+            AddFixup ( offset, m_EmptyString );
+          }
+
+          break;
+        case kSelect:
+          if ( value != 0 )
+          {
+            memcpy ( dest, &value->m_Select[ i ], sizeof ( uint32_t ) );
+          }
+          else if ( defaults )
+          {
+            Select* select = m_Definition->FindAggregate ( info->GetTypeNameHash() )->ToSelect();
+            uint32_t hash = select->GetDefaultItem() >= 0 ? ( *select ) [ select->GetDefaultItem() ]->GetNameHash() : 0;
+            memcpy ( dest, &hash, sizeof ( uint32_t ) );
+          }
+
+          break;
+        case kBitfield:
+        {
+          Bitfield* bitfield = m_Definition->FindAggregate ( info->GetTypeNameHash() )->ToBitfield();
+          uint32_t flags = 0;
+
+          if ( value != 0 )
+          {
+            StructBitfieldValue* bv = &*value->m_Bitfield[ i ];
+
+            for ( uint32_t j = 0; j < bv->GetCount(); j++ )
+            {
+              flags |= GetFlagValue ( bitfield, bitfield->FindFlag ( bv->GetHash ( j ) ) );
+            }
+          }
+          else if ( defaults && bitfield->GetDefaultFlag() >= 0 )
+          {
+            flags = GetFlagValue ( bitfield, ( *bitfield ) [ bitfield->GetDefaultFlag() ] );
+          }
+          else
+          {
+            break;
+          }
+
+          memcpy ( dest, &flags, sizeof ( uint32_t ) );
+        }
+        break;
+        case kStruct:
+        {
+          Struct* structure = m_Definition->FindAggregate ( info->GetTypeNameHash() )->ToStruct();
+
+          if ( defaults )
+          {
+            WriteStruct ( structure, offset );
+          }
+
+          if ( value != 0 )
+          {
+            WriteStructValue ( structure, &*value->m_Struct[ i ], offset );
+          }
+        }
+        break;
+        default:
+          // Unknown types stay NULL.
+          break;
+      }
+    }
+  }
+
+  static void
+  BuildDefaultImage ( LinearAllocator* definition, LinearAllocator* scratch, Definition* ddl, Struct* structure, const char* empty_string )
+  {
+    NativeLayout layout = GetNativeLayout ( ddl, structure );
+    // Allocate the tag with room for the field offsets.
+    DefaultImage* tag = ( DefaultImage* ) definition->SafeAllocate ( sizeof ( DefaultImage ) + layout.m_NumFields * sizeof ( uint32_t ), 4 );
+    memset ( tag, 0, sizeof ( DefaultImage ) );
+    tag->m_Size = sizeof ( DefaultImage );
+    tag->m_Type = kDefaultImage;
+    tag->m_InstanceSize = layout.m_Size;
+    tag->m_Alignment = layout.m_Alignment;
+    tag->m_NumFields = layout.m_NumFields;
+    GetNativeLayout ( ddl, structure, tag->m_FieldOffsets );
+    // Allocate the image.
+    uint8_t* image = ( uint8_t* ) definition->SafeAllocate ( layout.m_Size, layout.m_Alignment );
+    memset ( image, 0, layout.m_Size );
+    tag->m_Image = ( char* ) image;
+    // Write the defaults of each field.
+    ImageBuilder builder;
+    builder.m_Definition = ddl;
+    builder.m_Image = image;
+    builder.m_Fixups.Init ( scratch );
+    builder.m_NumFixups = 0;
+    builder.m_EmptyString = empty_string;
+
+    for ( uint32_t i = 0; i < layout.m_NumFields; i++ )
+    {
+      builder.WriteField ( ( *structure ) [ i ]->GetValueInfo(), tag->m_FieldOffsets[ i ], true );
+    }
+
+    // Copy the fixups to the definition.
+    DefaultImageFixup* fixups = ( DefaultImageFixup* ) definition->SafeAllocate ( builder.m_NumFixups * sizeof ( DefaultImageFixup ), 4 );
+    GrowableArray< PendingFixup >::Iterator it = builder.m_Fixups.Iterate();
+
+    for ( uint32_t i = 0; i < builder.m_NumFixups; i++ )
+    {
+      PendingFixup* pending = it.Next();
+      fixups[ i ].m_Offset = pending->m_Offset;
+      fixups[ i ].m_Value = pending->m_Value;
+    }
+
+    tag->m_NumFixups = builder.m_NumFixups;
+    tag->m_Fixups = builder.m_NumFixups != 0 ? fixups : 0;
+    builder.m_Fixups.Destroy();
+    // Link the tag.
+    tag->m_Next = structure->m_Tags.Get();
+    structure->m_Tags = tag;
+  }
+
+  bool
+  BuildDefaultImages ( LinearAllocator* definition, LinearAllocator* scratch, char* error, uint32_t error_size )
+  {
+    try
+    {
+      Definition* ddl = Definition::FromBinRep ( definition->GetBase() );
+      // Strings without a default value point to this one.
+      char* empty_string = ( char* ) definition->SafeAllocate ( 1 );
+      *empty_string = 0;
+
+      for ( uint32_t i = 0; i < ddl->GetNumAggregates(); i++ )
+      {
+        Aggregate* aggregate = ddl->GetAggregate ( i );
+
+        if ( aggregate->GetType() == kStruct && aggregate->ToStruct()->GetDefaultImage() == 0 )
+        {
+          BuildDefaultImage ( definition, scratch, ddl, aggregate->ToStruct(), empty_string );
+        }
+      }
+
+      ddl->m_TotalSize = ( uint32_t ) definition->GetCurrentOffset();
+      return true;
+    }
+    catch ( const char* the_error )
+    {
+      return ErrorThrown ( error, error_size, the_error );
+    }
+  }
+};
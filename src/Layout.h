@@ -0,0 +1,20 @@
+#pragma once
+
+#include <DDLParser.h>
+
+namespace DDLParser
+{
+  static inline uint32_t
+  AlignUp ( uint32_t offset, uint32_t alignment )
+  {
+    return ( offset + alignment - 1 ) & ~( alignment - 1 );
+  }
+
+  // Returns the native layout of a value of the given type.
+  NativeLayout GetTypeLayout ( Definition* ddl, uint32_t type, uint32_t type_name_hash );
+
+  // Adds a DefaultImage tag to the structures in the definition that don't
+  // have one yet. The images are appended to the definition, and its total
+  // size is updated.
+  bool BuildDefaultImages ( LinearAllocator* definition, LinearAllocator* scratch, char* error, uint32_t error_size );
+};
@@ -0,0 +1,834 @@
+#include <string.h>
+
+#include <DDLParser.h>
+
+#include "Layout.h"
+#include "Error.h"
+#include "GrowableArray.h"
+
+namespace DDLParser
+{
+  enum MigrationOpCode
+  {
+    kMigrateEnd,
+    // Instantiates the DefaultImage in m_Data at m_New.
+    kMigrateInit,
+    // Copies m_OldSize bytes.
+    kMigrateCopy,
+    // Converts m_Count numbers of type m_Arg >> 16 and m_OldSize bytes to
+    // type m_Arg & 0xffff and m_NewSize bytes.
+    kMigrateConvert,
+    // Remaps m_Count select values with the MigrationSelect in m_Data.
+    kMigrateSelect,
+    // Remaps m_Count bitfield values with the MigrationBitfield in m_Data.
+    kMigrateBitfield,
+    // Runs the program at m_Sub for m_Count elements, m_OldSize and m_NewSize
+    // bytes apart.
+    kMigrateRepeat,
+    // Allocates a new NativeArray with elements of m_NewSize bytes aligned to
+    // m_Arg and runs the program at m_Sub for each element.
+    kMigrateArray
+  };
+
+  struct MigrationOp
+  {
+    uint32_t    m_Code;
+    uint32_t    m_Old;
+    uint32_t    m_New;
+    uint32_t    m_OldSize;
+    uint32_t    m_NewSize;
+    uint32_t    m_Count;
+    uint32_t    m_Arg;
+    uint32_t    m_Sub;
+    const void* m_Data;
+  };
+
+  // Sorted item hashes of the new select.
+  struct MigrationSelect
+  {
+    uint32_t m_Default;
+    uint32_t m_NumItems;
+    uint32_t m_Items[ 1 ];
+  };
+
+  // Old flag bits and their new values.
+  struct MigrationBitfield
+  {
+    uint32_t m_NumFlags;
+    uint32_t m_Flags[ 1 ][ 2 ];
+  };
+
+  struct MigrationProgram
+  {
+    uint32_t    m_Entry;
+    uint32_t    m_NumOps;
+    uint32_t    m_OldSize;
+    uint32_t    m_NewSize;
+    // The structure didn't change, records are copied.
+    bool        m_Identical;
+    MigrationOp m_Ops[ 1 ];
+  };
+
+  static bool
+  IsNumber ( uint32_t type )
+  {
+    switch ( type )
+    {
+      case kUint8:
+      case kUint16:
+      case kUint32:
+      case kUint64:
+      case kInt8:
+      case kInt16:
+      case kInt32:
+      case kInt64:
+      case kFloat32:
+      case kFloat64:
+      case kBoolean:
+      case kTuid:
+        return true;
+    }
+
+    return false;
+  }
+
+  static bool
+  IsString ( uint32_t type )
+  {
+    return type == kString || type == kFile || type == kJson;
+  }
+
+  struct MigrationOpList
+  {
+    GrowableArray< MigrationOp > m_Ops;
+    uint32_t                     m_Count;
+    MigrationOp*                 m_Last;
+    // End of the last field visited in the new structure, the bytes between
+    // it and the next field are padding.
+    uint32_t                     m_NewEnd;
+
+    void Init ( LinearAllocator* scratch )
+    {
+      m_Ops.Init ( scratch );
+      m_Count = 0;
+      m_Last = 0;
+      m_NewEnd = 0;
+    }
+
+    MigrationOp* Add ( uint32_t code, uint32_t old_offset, uint32_t new_offset )
+    {
+      m_Last = m_Ops.Append();
+      memset ( m_Last, 0, sizeof ( MigrationOp ) );
+      m_Last->m_Code = code;
+      m_Last->m_Old = old_offset;
+      m_Last->m_New = new_offset;
+      m_Count++;
+      return m_Last;
+    }
+
+    void AddCopy ( uint32_t old_offset, uint32_t new_offset, uint32_t size )
+    {
+      // Merge with the previous copy if only padding is between them.
+      if ( m_Last != 0 && m_Last->m_Code == kMigrateCopy && m_Last->m_New + m_Last->m_OldSize == m_NewEnd )
+      {
+        uint32_t old_end = m_Last->m_Old + m_Last->m_OldSize;
+
+        if ( old_offset >= old_end && old_offset - old_end == new_offset - m_NewEnd )
+        {
+          m_Last->m_OldSize = new_offset + size - m_Last->m_New;
+          return;
+        }
+      }
+
+      Add ( kMigrateCopy, old_offset, new_offset )->m_OldSize = size;
+    }
+
+    // Returns true if the list copies all fields of an element that has the
+    // same size in both definitions.
+    bool IsPlain ( uint32_t old_size, uint32_t new_size ) const
+    {
+      return old_size == new_size && m_Count == 1 && m_Last->m_Code == kMigrateCopy && m_Last->m_Old == 0 && m_Last->m_New == 0 && m_Last->m_OldSize == m_NewEnd;
+    }
+  };
+
+  struct MigrationCompiler
+  {
+    Definition*      m_OldDefinition;
+    Definition*      m_NewDefinition;
+    LinearAllocator* m_Program;
+    LinearAllocator* m_Scratch;
+    // Finished programs, sub-programs come before the programs that use them.
+    MigrationOpList  m_Ops;
+
+    uint32_t Finish ( MigrationOpList* list, Struct* init, uint32_t init_offset );
+    void     AddStruct ( MigrationOpList* list, Struct* old_struct, Struct* new_struct, uint32_t old_offset, uint32_t new_offset );
+    void     AddField ( MigrationOpList* list, const StructValueInfo* old_info, const StructValueInfo* new_info, uint32_t old_offset, uint32_t new_offset );
+    bool     AddValue ( MigrationOpList* list, uint32_t old_type, uint32_t old_type_name_hash, uint32_t new_type, uint32_t new_type_name_hash, uint32_t count, uint32_t old_offset, uint32_t new_offset );
+    const MigrationSelect*   GetSelectMap ( Select* old_select, Select* new_select );
+    const MigrationBitfield* GetBitfieldMap ( Bitfield* old_bitfield, Bitfield* new_bitfield );
+  };
+
+  static const DefaultImage*
+  GetImage ( Struct* structure )
+  {
+    const DefaultImage* image = structure->GetDefaultImage();
+
+    if ( image == 0 )
+    {
+      throw "The new definition must be compiled with kCompileDefaultImages";
+    }
+
+    return image;
+  }
+
+  uint32_t
+  MigrationCompiler::Finish ( MigrationOpList* list, Struct* init, uint32_t init_offset )
+  {
+    uint32_t entry = m_Ops.m_Count;
+
+    if ( init != 0 )
+    {
+      m_Ops.Add ( kMigrateInit, 0, init_offset )->m_Data = GetImage ( init );
+    }
+
+    GrowableArray< MigrationOp >::Iterator it = list->m_Ops.Iterate();
+    MigrationOp* op;
+
+    while ( ( op = it.Next() ) != 0 )
+    {
+      *m_Ops.Add ( op->m_Code, 0, 0 ) = *op;
+    }
+
+    m_Ops.Add ( kMigrateEnd, 0, 0 );
+    return entry;
+  }
+
+  const MigrationSelect*
+  MigrationCompiler::GetSelectMap ( Select* old_select, Select* new_select )
+  {
+    bool identical = true;
+
+    for ( uint32_t i = 0; i < old_select->GetNumItems(); i++ )
+    {
+      identical = identical && new_select->FindItem ( ( *old_select ) [ i ]->GetNameHash() ) != 0;
+    }
+
+    if ( identical )
+    {
+      return 0;
+    }
+
+    uint32_t num_items = new_select->GetNumItems();
+    MigrationSelect* map = ( MigrationSelect* ) m_Program->SafeAllocate ( sizeof ( MigrationSelect ) + num_items * sizeof ( uint32_t ), 4 );
+    map->m_Default = new_select->GetDefaultItem() >= 0 ? ( *new_select ) [ new_select->GetDefaultItem() ]->GetNameHash() : 0;
+    map->m_NumItems = num_items;
+
+    // Insertion sort, selects are small.
+    for ( uint32_t i = 0; i < num_items; i++ )
+    {
+      uint32_t hash = ( *new_select ) [ i ]->GetNameHash();
+      uint32_t j = i;
+
+      for ( ; j > 0 && map->m_Items[ j - 1 ] > hash; j-- )
+      {
+        map->m_Items[ j ] = map->m_Items[ j - 1 ];
+      }
+
+      map->m_Items[ j ] = hash;
+    }
+
+    return map;
+  }
+
+  const MigrationBitfield*
+  MigrationCompiler::GetBitfieldMap ( Bitfield* old_bitfield, Bitfield* new_bitfield )
+  {
+    uint32_t num_flags = old_bitfield->GetNumFlags();
+    MigrationBitfield* map = ( MigrationBitfield* ) m_Program->SafeAllocate ( sizeof ( MigrationBitfield ) + num_flags * 2 * sizeof ( uint32_t ), 4 );
+    map->m_NumFlags = 0;
+    bool identical = true;
+
+    // Only flags with their own bits, the others are combinations of them.
+    for ( uint32_t i = 0; i < num_flags; i++ )
+    {
+      BitfieldFlag* old_flag = ( *old_bitfield ) [ i ];
+
+      if ( old_flag->GetBit() == 0 )
+      {
+        continue;
+      }
+
+      BitfieldFlag* new_flag = new_bitfield->FindFlag ( old_flag->GetNameHash() );
+      uint32_t old_bit = 1U << ( old_flag->GetBit() - 1 );
+      uint32_t new_bit = new_flag != 0 && new_flag->GetBit() != 0 ? 1U << ( new_flag->GetBit() - 1 ) : 0;
+      map->m_Flags[ map->m_NumFlags ][ 0 ] = old_bit;
+      map->m_Flags[ map->m_NumFlags ][ 1 ] = new_bit;
+      map->m_NumFlags++;
+      identical = identical && old_bit == new_bit;
+    }
+
+    return identical ? 0 : map;
+  }
+
+  void
+  MigrationCompiler::AddStruct ( MigrationOpList* list, Struct* old_struct, Struct* new_struct, uint32_t old_offset, uint32_t new_offset )
+  {
+    NativeLayout old_layout = GetNativeLayout ( m_OldDefinition, old_struct );
+    uint32_t* old_offsets = ( uint32_t* ) m_Scratch->SafeAllocate ( old_layout.m_NumFields * sizeof ( uint32_t ), 4 );
+    GetNativeLayout ( m_OldDefinition, old_struct, old_offsets );
+
+    NativeLayout new_layout = GetNativeLayout ( m_NewDefinition, new_struct );
+    uint32_t* new_offsets = ( uint32_t* ) m_Scratch->SafeAllocate ( new_layout.m_NumFields * sizeof ( uint32_t ), 4 );
+    GetNativeLayout ( m_NewDefinition, new_struct, new_offsets );
+
+    for ( uint32_t i = 0; i < new_layout.m_NumFields; i++ )
+    {
+      const StructValueInfo* new_info = ( *new_struct ) [ i ]->GetValueInfo();
+      const StructValueInfo* old_info = 0;
+      uint32_t j;
+
+      for ( j = 0; j < old_layout.m_NumFields; j++ )
+      {
+        if ( ( *old_struct ) [ j ]->GetValueInfo()->GetNameHash() == new_info->GetNameHash() )
+        {
+          old_info = ( *old_struct ) [ j ]->GetValueInfo();
+          break;
+        }
+      }
+
+      if ( old_info != 0 )
+      {
+        AddField ( list, old_info, new_info, old_offset + old_offsets[ j ], new_offset + new_offsets[ i ] );
+      }
+
+      // Nested structures that are converted in place set the end with their
+      // own fields.
+      bool nested = old_info != 0 && old_info->GetType() == kStruct && new_info->GetType() == kStruct && new_info->GetArrayType() == kScalar && ( old_info->GetArrayType() == kScalar || old_info->GetArrayType() == kFixed );
+
+      if ( !nested )
+      {
+        NativeLayout element = GetNativeLayout ( m_NewDefinition, new_info );
+        uint32_t size = new_info->GetArrayType() == kScalar || new_info->GetArrayType() == kFixed ? element.m_Size * new_info->GetCount() : sizeof ( NativeArray );
+        list->m_NewEnd = new_offset + new_offsets[ i ] + size;
+      }
+    }
+  }
+
+  void
+  MigrationCompiler::AddField ( MigrationOpList* list, const StructValueInfo* old_info, const StructValueInfo* new_info, uint32_t old_offset, uint32_t new_offset )
+  {
+    uint32_t old_array = old_info->GetArrayType();
+    uint32_t new_array = new_info->GetArrayType();
+
+    if ( ( old_array == kScalar || old_array == kFixed ) && ( new_array == kScalar || new_array == kFixed ) )
+    {
+      // Extra elements keep their default values.
+      uint32_t count = old_info->GetCount() < new_info->GetCount() ? old_info->GetCount() : new_info->GetCount();
+      AddValue ( list, old_info->GetType(), old_info->GetTypeNameHash(), new_info->GetType(), new_info->GetTypeNameHash(), count, old_offset, new_offset );
+      return;
+    }
+
+    if ( old_array != new_array )
+    {
+      // Changes between fixed and dynamic arrays and hashmaps aren't
+      // supported, the field keeps its default value.
+      return;
+    }
+
+    // Dynamic arrays and hashmaps, hashmap elements are the key followed by
+    // the value.
+    NativeLayout old_layout = GetNativeLayout ( m_OldDefinition, old_info );
+    NativeLayout new_layout = GetNativeLayout ( m_NewDefinition, new_info );
+    MigrationOpList element;
+    element.Init ( m_Scratch );
+    uint32_t old_value = 0;
+    uint32_t new_value = 0;
+
+    if ( new_array == kHashmap )
+    {
+      if ( !AddValue ( &element, old_info->GetKeyType(), 0, new_info->GetKeyType(), 0, 1, 0, 0 ) )
+      {
+        return;
+      }
+
+      element.m_NewEnd = GetTypeLayout ( m_NewDefinition, new_info->GetKeyType(), 0 ).m_Size;
+      NativeLayout old_key = GetTypeLayout ( m_OldDefinition, old_info->GetKeyType(), 0 );
+      NativeLayout new_key = GetTypeLayout ( m_NewDefinition, new_info->GetKeyType(), 0 );
+      old_value = AlignUp ( old_key.m_Size, GetTypeLayout ( m_OldDefinition, old_info->GetType(), old_info->GetTypeNameHash() ).m_Alignment );
+      new_value = AlignUp ( new_key.m_Size, GetTypeLayout ( m_NewDefinition, new_info->GetType(), new_info->GetTypeNameHash() ).m_Alignment );
+    }
+
+    if ( !AddValue ( &element, old_info->GetType(), old_info->GetTypeNameHash(), new_info->GetType(), new_info->GetTypeNameHash(), 1, old_value, new_value ) )
+    {
+      return;
+    }
+
+    if ( new_info->GetType() != kStruct )
+    {
+      element.m_NewEnd = new_value + GetTypeLayout ( m_NewDefinition, new_info->GetType(), new_info->GetTypeNameHash() ).m_Size;
+    }
+
+    if ( element.IsPlain ( old_layout.m_Size, new_layout.m_Size ) )
+    {
+      // Share the elements with the old record.
+      list->AddCopy ( old_offset, new_offset, sizeof ( NativeArray ) );
+      return;
+    }
+
+    // Structures get their defaults before being converted.
+    Struct* init = new_info->GetType() == kStruct ? m_NewDefinition->FindAggregate ( new_info->GetTypeNameHash() )->ToStruct() : 0;
+    uint32_t sub = Finish ( &element, init, new_value );
+    MigrationOp* op = list->Add ( kMigrateArray, old_offset, new_offset );
+    op->m_OldSize = old_layout.m_Size;
+    op->m_NewSize = new_layout.m_Size;
+    op->m_Arg = new_layout.m_Alignment;
+    op->m_Sub = sub;
+  }
+
+  bool
+  MigrationCompiler::AddValue ( MigrationOpList* list, uint32_t old_type, uint32_t old_type_name_hash, uint32_t new_type, uint32_t new_type_name_hash, uint32_t count, uint32_t old_offset, uint32_t new_offset )
+  {
+    NativeLayout old_layout = GetTypeLayout ( m_OldDefinition, old_type, old_type_name_hash );
+    NativeLayout new_layout = GetTypeLayout ( m_NewDefinition, new_type, new_type_name_hash );
+
+    if ( IsNumber ( old_type ) && IsNumber ( new_type ) )
+    {
+      if ( old_type == new_type )
+      {
+        list->AddCopy ( old_offset, new_offset, new_layout.m_Size * count );
+        return true;
+      }
+
+      MigrationOp* op = list->Add ( kMigrateConvert, old_offset, new_offset );
+      op->m_OldSize = old_layout.m_Size;
+      op->m_NewSize = new_layout.m_Size;
+      op->m_Count = count;
+      op->m_Arg = old_type << 16 | new_type;
+      return true;
+    }
+
+    if ( IsString ( old_type ) && IsString ( new_type ) )
+    {
+      list->AddCopy ( old_offset, new_offset, new_layout.m_Size * count );
+      return true;
+    }
+
+    if ( old_type != new_type )
+    {
+      return false;
+    }
+
+    Aggregate* old_aggregate = m_OldDefinition->FindAggregate ( old_type_name_hash );
+    Aggregate* new_aggregate = m_NewDefinition->FindAggregate ( new_type_name_hash );
+
+    switch ( new_type )
+    {
+      case kSelect:
+      {
+        const MigrationSelect* map = GetSelectMap ( old_aggregate->ToSelect(), new_aggregate->ToSelect() );
+
+        if ( map == 0 )
+        {
+          list->AddCopy ( old_offset, new_offset, new_layout.m_Size * count );
+          return true;
+        }
+
+        MigrationOp* op = list->Add ( kMigrateSelect, old_offset, new_offset );
+        op->m_Count = count;
+        op->m_Data = map;
+      }
+
+      return true;
+      case kBitfield:
+      {
+        const MigrationBitfield* map = GetBitfieldMap ( old_aggregate->ToBitfield(), new_aggregate->ToBitfield() );
+
+        if ( map == 0 )
+        {
+          list->AddCopy ( old_offset, new_offset, new_layout.m_Size * count );
+          return true;
+        }
+
+        MigrationOp* op = list->Add ( kMigrateBitfield, old_offset, new_offset );
+        op->m_Count = count;
+        op->m_Data = map;
+      }
+
+      return true;
+      case kStruct:
+      {
+        if ( count == 1 )
+        {
+          AddStruct ( list, old_aggregate->ToStruct(), new_aggregate->ToStruct(), old_offset, new_offset );
+          return true;
+        }
+
+        MigrationOpList element;
+        element.Init ( m_Scratch );
+        AddStruct ( &element, old_aggregate->ToStruct(), new_aggregate->ToStruct(), 0, 0 );
+
+        if ( element.IsPlain ( old_layout.m_Size, new_layout.m_Size ) )
+        {
+          list->AddCopy ( old_offset, new_offset, new_layout.m_Size * count );
+          return true;
+        }
+
+        // The elements already have their defaults.
+        uint32_t sub = Finish ( &element, 0, 0 );
+        MigrationOp* op = list->Add ( kMigrateRepeat, old_offset, new_offset );
+        op->m_OldSize = old_layout.m_Size;
+        op->m_NewSize = new_layout.m_Size;
+        op->m_Count = count;
+        op->m_Sub = sub;
+      }
+
+      return true;
+    }
+
+    // Unknown types.
+    return false;
+  }
+
+  MigrationProgram*
+  CompileMigration ( LinearAllocator* program, LinearAllocator* scratch, Definition* old_ddl, Definition* new_ddl, const char* name, char* error, size_t error_size )
+  {
+    try
+    {
+      Aggregate* old_aggregate = old_ddl->FindAggregate ( name );
+      Aggregate* new_aggregate = new_ddl->FindAggregate ( name );
+
+      if ( old_aggregate == 0 || old_aggregate->GetType() != kStruct || new_aggregate == 0 || new_aggregate->GetType() != kStruct )
+      {
+        throw "Structure not found";
+      }
+
+      MigrationCompiler compiler;
+      compiler.m_OldDefinition = old_ddl;
+      compiler.m_NewDefinition = new_ddl;
+      compiler.m_Program = program;
+      compiler.m_Scratch = scratch;
+      compiler.m_Ops.Init ( scratch );
+
+      Struct* old_struct = old_aggregate->ToStruct();
+      Struct* new_struct = new_aggregate->ToStruct();
+      uint32_t old_size = GetNativeLayout ( old_ddl, old_struct ).m_Size;
+      uint32_t new_size = GetNativeLayout ( new_ddl, new_struct ).m_Size;
+
+      MigrationOpList main;
+      main.Init ( scratch );
+      compiler.AddStruct ( &main, old_struct, new_struct, 0, 0 );
+      bool identical = main.IsPlain ( old_size, new_size );
+      uint32_t entry = compiler.Finish ( &main, new_struct, 0 );
+
+      // Copy the ops to the program.
+      uint32_t num_ops = compiler.m_Ops.m_Count;
+      MigrationProgram* result = ( MigrationProgram* ) program->SafeAllocate ( sizeof ( MigrationProgram ) + ( num_ops - 1 ) * sizeof ( MigrationOp ), sizeof ( void* ) );
+      result->m_Entry = entry;
+      result->m_NumOps = num_ops;
+      result->m_OldSize = old_size;
+      result->m_NewSize = new_size;
+      result->m_Identical = identical;
+
+      GrowableArray< MigrationOp >::Iterator it = compiler.m_Ops.m_Ops.Iterate();
+
+      for ( uint32_t i = 0; i < num_ops; i++ )
+      {
+        result->m_Ops[ i ] = *it.Next();
+      }
+
+      return result;
+    }
+    catch ( const char* the_error )
+    {
+      ErrorThrown ( error, ( uint32_t ) error_size, the_error );
+      return 0;
+    }
+  }
+
+  // A number read as the widest type of its kind.
+  struct MigrationNumber
+  {
+    enum
+    {
+      kUnsigned,
+      kSigned,
+      kFloat
+    };
+
+    int      m_Kind;
+    uint64_t m_Unsigned;
+    int64_t  m_Signed;
+    double   m_Float;
+
+    void Read ( uint32_t type, const uint8_t* value )
+    {
+      m_Kind = kUnsigned;
+
+      switch ( type )
+      {
+        case kUint8:
+        case kBoolean:
+          m_Unsigned = *( const uint8_t* ) value;
+          return;
+        case kUint16:
+          m_Unsigned = *( const uint16_t* ) value;
+          return;
+        case kUint32:
+          m_Unsigned = *( const uint32_t* ) value;
+          return;
+        case kUint64:
+        case kTuid:
+          m_Unsigned = *( const uint64_t* ) value;
+          return;
+      }
+
+      m_Kind = kSigned;
+
+      switch ( type )
+      {
+        case kInt8:
+          m_Signed = *( const int8_t* ) value;
+          return;
+        case kInt16:
+          m_Signed = *( const int16_t* ) value;
+          return;
+        case kInt32:
+          m_Signed = *( const int32_t* ) value;
+          return;
+        case kInt64:
+          m_Signed = *( const int64_t* ) value;
+          return;
+      }
+
+      m_Kind = kFloat;
+      m_Float = type == kFloat32 ? *( const float* ) value : *( const double* ) value;
+    }
+
+    uint64_t ToUnsigned ( uint64_t max ) const
+    {
+      switch ( m_Kind )
+      {
+        case kUnsigned:
+          return m_Unsigned > max ? max : m_Unsigned;
+        case kSigned:
+          return m_Signed < 0 ? 0 : ( uint64_t ) m_Signed > max ? max : ( uint64_t ) m_Signed;
+      }
+
+      // Also catches NaNs.
+      return !( m_Float > 0 ) ? 0 : m_Float >= ( double ) max ? max : ( uint64_t ) m_Float;
+    }
+
+    int64_t ToSigned ( int64_t min, int64_t max ) const
+    {
+      switch ( m_Kind )
+      {
+        case kUnsigned:
+          return m_Unsigned > ( uint64_t ) max ? max : ( int64_t ) m_Unsigned;
+        case kSigned:
+          return m_Signed < min ? min : m_Signed > max ? max : m_Signed;
+      }
+
+      return m_Float != m_Float ? 0 : m_Float <= ( double ) min ? min : m_Float >= ( double ) max ? max : ( int64_t ) m_Float;
+    }
+
+    double ToFloat() const
+    {
+      return m_Kind == kUnsigned ? ( double ) m_Unsigned : m_Kind == kSigned ? ( double ) m_Signed : m_Float;
+    }
+
+    void Write ( uint32_t type, uint8_t* value ) const
+    {
+      switch ( type )
+      {
+        case kUint8:
+          *( uint8_t* ) value = ( uint8_t ) ToUnsigned ( UINT8_MAX );
+          break;
+        case kUint16:
+          *( uint16_t* ) value = ( uint16_t ) ToUnsigned ( UINT16_MAX );
+          break;
+        case kUint32:
+          *( uint32_t* ) value = ( uint32_t ) ToUnsigned ( UINT32_MAX );
+          break;
+        case kUint64:
+        case kTuid:
+          *( uint64_t* ) value = ToUnsigned ( UINT64_MAX );
+          break;
+        case kBoolean:
+          *( uint8_t* ) value = ToFloat() != 0;
+          break;
+        case kInt8:
+          *( int8_t* ) value = ( int8_t ) ToSigned ( INT8_MIN, INT8_MAX );
+          break;
+        case kInt16:
+          *( int16_t* ) value = ( int16_t ) ToSigned ( INT16_MIN, INT16_MAX );
+          break;
+        case kInt32:
+          *( int32_t* ) value = ( int32_t ) ToSigned ( INT32_MIN, INT32_MAX );
+          break;
+        case kInt64:
+          *( int64_t* ) value = ToSigned ( INT64_MIN, INT64_MAX );
+          break;
+        case kFloat32:
+          *( float* ) value = ( float ) ToFloat();
+          break;
+        case kFloat64:
+          *( double* ) value = ToFloat();
+          break;
+      }
+    }
+  };
+
+  static uint32_t
+  MapSelect ( const MigrationSelect* map, uint32_t hash )
+  {
+    uint32_t low = 0;
+    uint32_t high = map->m_NumItems;
+
+    while ( low < high )
+    {
+      uint32_t middle = low + ( high - low ) / 2;
+
+      if ( map->m_Items[ middle ] == hash )
+      {
+        return hash;
+      }
+      else if ( map->m_Items[ middle ] < hash )
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+
+    return map->m_Default;
+  }
+
+  static uint32_t
+  MapBitfield ( const MigrationBitfield* map, uint32_t value )
+  {
+    uint32_t result = 0;
+
+    for ( uint32_t i = 0; i < map->m_NumFlags; i++ )
+    {
+      if ( ( value & map->m_Flags[ i ][ 0 ] ) != 0 )
+      {
+        result |= map->m_Flags[ i ][ 1 ];
+      }
+    }
+
+    return result;
+  }
+
+  static bool
+  Convert ( const MigrationOp* ops, uint32_t entry, const uint8_t* old_record, uint8_t* new_record, LinearAllocator* allocator )
+  {
+    for ( const MigrationOp* op = ops + entry; op->m_Code != kMigrateEnd; op++ )
+    {
+      const uint8_t* old_field = old_record + op->m_Old;
+      uint8_t* new_field = new_record + op->m_New;
+
+      switch ( op->m_Code )
+      {
+        case kMigrateInit:
+          ( ( const DefaultImage* ) op->m_Data )->Instantiate ( new_field );
+          break;
+        case kMigrateCopy:
+          memcpy ( new_field, old_field, op->m_OldSize );
+          break;
+        case kMigrateConvert:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            MigrationNumber number;
+            number.Read ( op->m_Arg >> 16, old_field + i * op->m_OldSize );
+            number.Write ( op->m_Arg & 0xffff, new_field + i * op->m_NewSize );
+          }
+
+          break;
+        case kMigrateSelect:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            ( ( uint32_t* ) new_field ) [ i ] = MapSelect ( ( const MigrationSelect* ) op->m_Data, ( ( const uint32_t* ) old_field ) [ i ] );
+          }
+
+          break;
+        case kMigrateBitfield:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            ( ( uint32_t* ) new_field ) [ i ] = MapBitfield ( ( const MigrationBitfield* ) op->m_Data, ( ( const uint32_t* ) old_field ) [ i ] );
+          }
+
+          break;
+        case kMigrateRepeat:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            if ( !Convert ( ops, op->m_Sub, old_field + i * op->m_OldSize, new_field + i * op->m_NewSize, allocator ) )
+            {
+              return false;
+            }
+          }
+
+          break;
+        case kMigrateArray:
+        {
+          const NativeArray* old_array = ( const NativeArray* ) old_field;
+          NativeArray* new_array = ( NativeArray* ) new_field;
+          new_array->m_Elements = 0;
+          new_array->m_Count = old_array->m_Count;
+
+          if ( old_array->m_Count == 0 )
+          {
+            break;
+          }
+
+          uint8_t* elements = ( uint8_t* ) allocator->Allocate ( ( size_t ) old_array->m_Count * op->m_NewSize, op->m_Arg );
+
+          if ( elements == 0 )
+          {
+            return false;
+          }
+
+          new_array->m_Elements = elements;
+
+          for ( uint32_t i = 0; i < old_array->m_Count; i++ )
+          {
+            if ( !Convert ( ops, op->m_Sub, ( const uint8_t* ) old_array->m_Elements + i * op->m_OldSize, elements + i * op->m_NewSize, allocator ) )
+            {
+              return false;
+            }
+          }
+        }
+        break;
+      }
+    }
+
+    return true;
+  }
+
+  bool
+  Migrate ( const MigrationProgram* program, const void* old_records, void* new_records, size_t num_records, LinearAllocator* allocator )
+  {
+    if ( program->m_Identical )
+    {
+      memcpy ( new_records, old_records, num_records * program->m_NewSize );
+      return true;
+    }
+
+    const uint8_t* old_record = ( const uint8_t* ) old_records;
+    uint8_t* new_record = ( uint8_t* ) new_records;
+
+    for ( size_t i = 0; i < num_records; i++ )
+    {
+      if ( !Convert ( program->m_Ops, program->m_Entry, old_record, new_record, allocator ) )
+      {
+        return false;
+      }
+
+      old_record += program->m_OldSize;
+      new_record += program->m_NewSize;
+    }
+
+    return true;
+  }
+};
@@ -0,0 +1,509 @@
+#include <string.h>
+
+#include <DDLParser.h>
+
+#include "Layout.h"
+#include "Error.h"
+#include "GrowableArray.h"
+
+namespace DDLParser
+{
+  enum SerializerOpCode
+  {
+    kOpEnd,
+    // Copies m_Size bytes.
+    kOpCopy,
+    // m_Count strings.
+    kOpString,
+    // m_Count elements m_Size bytes apart, each one run by the program at
+    // m_Sub.
+    kOpRepeat,
+    // A NativeArray with elements of m_Size bytes aligned to m_Count, each
+    // one run by the program at m_Sub.
+    kOpArray,
+    // A NativeArray with plain elements of m_Size bytes aligned to m_Count,
+    // copied in bulk.
+    kOpArrayCopy
+  };
+
+  struct SerializerOp
+  {
+    uint32_t m_Code;
+    uint32_t m_Offset;
+    uint32_t m_Size;
+    uint32_t m_Count;
+    uint32_t m_Sub;
+    // Minimum number of bytes read for each element of kOpRepeat, kOpArray
+    // and kOpArrayCopy, to reject counts that don't fit in the input.
+    uint32_t m_MinSize;
+  };
+
+  struct SerializerProgram
+  {
+    uint32_t     m_Entry;
+    uint32_t     m_NumOps;
+    SerializerOp m_Ops[ 1 ];
+  };
+
+  struct OpList
+  {
+    GrowableArray< SerializerOp > m_Ops;
+    uint32_t                      m_Count;
+    SerializerOp*                 m_Last;
+    // Minimum number of bytes read by the ops in the list.
+    uint32_t                      m_MinSize;
+
+    void Init ( LinearAllocator* scratch )
+    {
+      m_Ops.Init ( scratch );
+      m_Count = 0;
+      m_Last = 0;
+      m_MinSize = 0;
+    }
+
+    void Add ( uint32_t code, uint32_t offset, uint32_t size, uint32_t count, uint32_t sub, uint32_t min_size = 0 )
+    {
+      m_Last = m_Ops.Append();
+      m_Last->m_Code = code;
+      m_Last->m_Offset = offset;
+      m_Last->m_Size = size;
+      m_Last->m_Count = count;
+      m_Last->m_Sub = sub;
+      m_Last->m_MinSize = min_size;
+      m_Count++;
+
+      switch ( code )
+      {
+        case kOpCopy:
+          m_MinSize += size;
+          break;
+        case kOpString:
+          m_MinSize += count * sizeof ( uint32_t );
+          break;
+        case kOpRepeat:
+          m_MinSize += count * min_size;
+          break;
+        case kOpArray:
+        case kOpArrayCopy:
+          m_MinSize += sizeof ( uint32_t );
+          break;
+      }
+    }
+
+    void AddCopy ( uint32_t offset, uint32_t size )
+    {
+      // Merge with the previous copy if there's no padding between them.
+      if ( m_Last != 0 && m_Last->m_Code == kOpCopy && m_Last->m_Offset + m_Last->m_Size == offset )
+      {
+        m_Last->m_Size += size;
+        m_MinSize += size;
+        return;
+      }
+
+      Add ( kOpCopy, offset, size, 0, 0 );
+    }
+
+    // Returns true if the list copies size bytes from offset zero.
+    bool IsPlain ( uint32_t size ) const
+    {
+      return m_Count == 1 && m_Last->m_Code == kOpCopy && m_Last->m_Offset == 0 && m_Last->m_Size == size;
+    }
+  };
+
+  struct SerializerCompiler
+  {
+    Definition*      m_Definition;
+    LinearAllocator* m_Scratch;
+    // Finished programs, sub-programs come before the programs that use them.
+    OpList           m_Program;
+
+    uint32_t Finish ( OpList* list );
+    void     AddStruct ( OpList* list, Struct* structure, uint32_t offset );
+    void     AddValue ( OpList* list, uint32_t type, uint32_t type_name_hash, uint32_t count, uint32_t offset );
+    void     AddField ( OpList* list, const StructValueInfo* info, uint32_t offset );
+  };
+
+  uint32_t
+  SerializerCompiler::Finish ( OpList* list )
+  {
+    uint32_t entry = m_Program.m_Count;
+    GrowableArray< SerializerOp >::Iterator it = list->m_Ops.Iterate();
+    SerializerOp* op;
+
+    while ( ( op = it.Next() ) != 0 )
+    {
+      m_Program.Add ( op->m_Code, op->m_Offset, op->m_Size, op->m_Count, op->m_Sub, op->m_MinSize );
+    }
+
+    m_Program.Add ( kOpEnd, 0, 0, 0, 0 );
+    return entry;
+  }
+
+  void
+  SerializerCompiler::AddStruct ( OpList* list, Struct* structure, uint32_t offset )
+  {
+    NativeLayout layout = GetNativeLayout ( m_Definition, structure );
+    uint32_t* offsets = ( uint32_t* ) m_Scratch->SafeAllocate ( layout.m_NumFields * sizeof ( uint32_t ), 4 );
+    GetNativeLayout ( m_Definition, structure, offsets );
+
+    for ( uint32_t i = 0; i < layout.m_NumFields; i++ )
+    {
+      AddField ( list, ( *structure ) [ i ]->GetValueInfo(), offset + offsets[ i ] );
+    }
+  }
+
+  void
+  SerializerCompiler::AddValue ( OpList* list, uint32_t type, uint32_t type_name_hash, uint32_t count, uint32_t offset )
+  {
+    switch ( type )
+    {
+      case kUint8:
+      case kInt8:
+      case kBoolean:
+      case kUint16:
+      case kInt16:
+      case kUint32:
+      case kInt32:
+      case kUint64:
+      case kInt64:
+      case kTuid:
+      case kFloat32:
+      case kFloat64:
+      case kSelect:
+      case kBitfield:
+        list->AddCopy ( offset, GetTypeLayout ( m_Definition, type, type_name_hash ).m_Size * count );
+        return;
+      case kString:
+      case kFile:
+      case kJson:
+        list->Add ( kOpString, offset, 0, count, 0 );
+        return;
+      case kStruct:
+      {
+        Struct* structure = m_Definition->FindAggregate ( type_name_hash )->ToStruct();
+
+        if ( count == 1 )
+        {
+          AddStruct ( list, structure, offset );
+          return;
+        }
+
+        uint32_t stride = GetNativeLayout ( m_Definition, structure ).m_Size;
+        OpList element;
+        element.Init ( m_Scratch );
+        AddStruct ( &element, structure, 0 );
+
+        if ( element.IsPlain ( stride ) )
+        {
+          list->AddCopy ( offset, stride * count );
+        }
+        else
+        {
+          list->Add ( kOpRepeat, offset, stride, count, Finish ( &element ), element.m_MinSize );
+        }
+      }
+
+      return;
+    }
+
+    throw "Fields of unknown types can't be serialized";
+  }
+
+  void
+  SerializerCompiler::AddField ( OpList* list, const StructValueInfo* info, uint32_t offset )
+  {
+    if ( info->GetArrayType() == kScalar || info->GetArrayType() == kFixed )
+    {
+      AddValue ( list, info->GetType(), info->GetTypeNameHash(), info->GetCount(), offset );
+      return;
+    }
+
+    // Dynamic arrays and hashmaps, hashmap elements are the key followed by
+    // the value.
+    NativeLayout layout = GetNativeLayout ( m_Definition, info );
+    OpList element;
+    element.Init ( m_Scratch );
+    uint32_t value_offset = 0;
+
+    if ( info->GetArrayType() == kHashmap )
+    {
+      NativeLayout key = GetTypeLayout ( m_Definition, info->GetKeyType(), 0 );
+      NativeLayout value = GetTypeLayout ( m_Definition, info->GetType(), info->GetTypeNameHash() );
+      AddValue ( &element, info->GetKeyType(), 0, 1, 0 );
+      value_offset = AlignUp ( key.m_Size, value.m_Alignment );
+    }
+
+    AddValue ( &element, info->GetType(), info->GetTypeNameHash(), 1, value_offset );
+
+    if ( element.IsPlain ( layout.m_Size ) )
+    {
+      list->Add ( kOpArrayCopy, offset, layout.m_Size, layout.m_Alignment, 0, layout.m_Size );
+    }
+    else
+    {
+      list->Add ( kOpArray, offset, layout.m_Size, layout.m_Alignment, Finish ( &element ), element.m_MinSize );
+    }
+  }
+
+  SerializerProgram*
+  CompileSerializer ( LinearAllocator* program, LinearAllocator* scratch, Definition* ddl, Struct* structure, char* error, size_t error_size )
+  {
+    try
+    {
+      SerializerCompiler compiler;
+      compiler.m_Definition = ddl;
+      compiler.m_Scratch = scratch;
+      compiler.m_Program.Init ( scratch );
+
+      OpList main;
+      main.Init ( scratch );
+      compiler.AddStruct ( &main, structure, 0 );
+      uint32_t entry = compiler.Finish ( &main );
+
+      // Copy the ops to the program.
+      uint32_t num_ops = compiler.m_Program.m_Count;
+      SerializerProgram* result = ( SerializerProgram* ) program->SafeAllocate ( sizeof ( SerializerProgram ) + ( num_ops - 1 ) * sizeof ( SerializerOp ), 4 );
+      result->m_Entry = entry;
+      result->m_NumOps = num_ops;
+
+      GrowableArray< SerializerOp >::Iterator it = compiler.m_Program.m_Ops.Iterate();
+
+      for ( uint32_t i = 0; i < num_ops; i++ )
+      {
+        result->m_Ops[ i ] = *it.Next();
+      }
+
+      return result;
+    }
+    catch ( const char* the_error )
+    {
+      ErrorThrown ( error, ( uint32_t ) error_size, the_error );
+      return 0;
+    }
+  }
+
+  struct Writer
+  {
+    uint8_t* m_Buffer;
+    size_t   m_Capacity;
+    size_t   m_Size;
+
+    inline void Write ( const void* data, size_t size )
+    {
+      // Keep counting after the buffer is full so we can return the size
+      // needed.
+      if ( size != 0 && m_Size + size <= m_Capacity )
+      {
+        memcpy ( m_Buffer + m_Size, data, size );
+      }
+
+      m_Size += size;
+    }
+  };
+
+  static void
+  Save ( const SerializerOp* ops, uint32_t entry, const uint8_t* instance, Writer* writer )
+  {
+    for ( const SerializerOp* op = ops + entry; op->m_Code != kOpEnd; op++ )
+    {
+      const uint8_t* field = instance + op->m_Offset;
+
+      switch ( op->m_Code )
+      {
+        case kOpCopy:
+          writer->Write ( field, op->m_Size );
+          break;
+        case kOpString:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            const char* str = ( ( const char* const* ) field ) [ i ];
+            uint32_t length = str != 0 ? ( uint32_t ) strlen ( str ) : 0;
+            writer->Write ( &length, sizeof ( length ) );
+            writer->Write ( str, length );
+          }
+
+          break;
+        case kOpRepeat:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            Save ( ops, op->m_Sub, field + i * op->m_Size, writer );
+          }
+
+          break;
+        case kOpArray:
+        {
+          const NativeArray* array = ( const NativeArray* ) field;
+          const uint8_t* elements = ( const uint8_t* ) array->m_Elements;
+          writer->Write ( &array->m_Count, sizeof ( array->m_Count ) );
+
+          for ( uint32_t i = 0; i < array->m_Count; i++ )
+          {
+            Save ( ops, op->m_Sub, elements + i * op->m_Size, writer );
+          }
+        }
+        break;
+        case kOpArrayCopy:
+        {
+          const NativeArray* array = ( const NativeArray* ) field;
+          writer->Write ( &array->m_Count, sizeof ( array->m_Count ) );
+          writer->Write ( array->m_Elements, ( size_t ) array->m_Count * op->m_Size );
+        }
+        break;
+      }
+    }
+  }
+
+  size_t
+  Serialize ( const SerializerProgram* program, const void* instance, void* buffer, size_t buffer_size )
+  {
+    Writer writer;
+    writer.m_Buffer = ( uint8_t* ) buffer;
+    writer.m_Capacity = buffer_size;
+    writer.m_Size = 0;
+    Save ( program->m_Ops, program->m_Entry, ( const uint8_t* ) instance, &writer );
+    return writer.m_Size;
+  }
+
+  struct Reader
+  {
+    const uint8_t*   m_Data;
+    const uint8_t*   m_End;
+    LinearAllocator* m_Allocator;
+
+    inline bool Read ( void* data, size_t size )
+    {
+      if ( ( size_t ) ( m_End - m_Data ) < size )
+      {
+        return false;
+      }
+
+      memcpy ( data, m_Data, size );
+      m_Data += size;
+      return true;
+    }
+  };
+
+  static bool
+  Load ( const SerializerOp* ops, uint32_t entry, uint8_t* instance, Reader* reader )
+  {
+    for ( const SerializerOp* op = ops + entry; op->m_Code != kOpEnd; op++ )
+    {
+      uint8_t* field = instance + op->m_Offset;
+
+      switch ( op->m_Code )
+      {
+        case kOpCopy:
+          if ( !reader->Read ( field, op->m_Size ) )
+          {
+            return false;
+          }
+
+          break;
+        case kOpString:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            uint32_t length;
+
+            // Check the length before allocating, so corrupt input can't
+            // ask for more memory than it could fill.
+            if ( !reader->Read ( &length, sizeof ( length ) ) || length > ( size_t ) ( reader->m_End - reader->m_Data ) )
+            {
+              return false;
+            }
+
+            char* str = ( char* ) reader->m_Allocator->Allocate ( ( size_t ) length + 1 );
+
+            if ( str == 0 || !reader->Read ( str, length ) )
+            {
+              return false;
+            }
+
+            str[ length ] = 0;
+            ( ( const char** ) field ) [ i ] = str;
+          }
+
+          break;
+        case kOpRepeat:
+          for ( uint32_t i = 0; i < op->m_Count; i++ )
+          {
+            if ( !Load ( ops, op->m_Sub, field + i * op->m_Size, reader ) )
+            {
+              return false;
+            }
+          }
+
+          break;
+        case kOpArray:
+        case kOpArrayCopy:
+        {
+          NativeArray* array = ( NativeArray* ) field;
+
+          if ( !reader->Read ( &array->m_Count, sizeof ( array->m_Count ) ) )
+          {
+            return false;
+          }
+
+          size_t size = ( size_t ) array->m_Count * op->m_Size;
+          array->m_Elements = 0;
+
+          if ( array->m_Count == 0 )
+          {
+            break;
+          }
+
+          // Each element takes at least m_MinSize bytes of input, elements of
+          // empty structures are counted as one byte so their count is
+          // bounded too.
+          uint32_t min_size = op->m_MinSize != 0 ? op->m_MinSize : 1;
+
+          if ( array->m_Count > ( size_t ) ( reader->m_End - reader->m_Data ) / min_size )
+          {
+            return false;
+          }
+
+          uint8_t* elements = ( uint8_t* ) reader->m_Allocator->Allocate ( size, op->m_Count );
+
+          if ( elements == 0 )
+          {
+            return false;
+          }
+
+          array->m_Elements = elements;
+
+          if ( op->m_Code == kOpArrayCopy )
+          {
+            reader->Read ( elements, size );
+            break;
+          }
+
+          for ( uint32_t i = 0; i < array->m_Count; i++ )
+          {
+            if ( !Load ( ops, op->m_Sub, elements + i * op->m_Size, reader ) )
+            {
+              return false;
+            }
+          }
+        }
+        break;
+      }
+    }
+
+    return true;
+  }
+
+  size_t
+  Deserialize ( const SerializerProgram* program, void* instance, const void* buffer, size_t buffer_size, LinearAllocator* allocator )
+  {
+    Reader reader;
+    reader.m_Data = ( const uint8_t* ) buffer;
+    reader.m_End = reader.m_Data + buffer_size;
+    reader.m_Allocator = allocator;
+
+    if ( !Load ( program->m_Ops, program->m_Entry, ( uint8_t* ) instance, &reader ) )
+    {
+      return 0;
+    }
+
+    return ( size_t ) ( reader.m_Data - ( const uint8_t* ) buffer );
+  }
+};
@@ -0,0 +1,664 @@
+#pragma once
+
+// Pull parser for reading JSON data written by JsonWriteScope back into the
+// generated classes. It works directly on the input buffer and never allocates;
+// only the strings being read into may grow.
+//
+// Object keys and select values are hashed with the same CRC-32 as
+// DDLParser::StringCrc32 while they are scanned, so the generated code can
+// dispatch on them with a switch and confirm the match with a single compare.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+
+#if __cplusplus >= 201703L && defined( __has_include )
+  #if __has_include( <charconv> )
+    #include <charconv>
+  #endif
+#endif
+
+#if defined( __cpp_lib_to_chars ) && __cpp_lib_to_chars >= 201611L
+  #define JSON_READ_FROM_CHARS 1
+#endif
+
+class JsonReader
+{
+  public:
+    // Longest key or select value kept for comparison, longer ones never match.
+    enum { kMaxKeyLength = 256 };
+    // Maximum nesting of the values skipped by SkipValue.
+    enum { kMaxSkipDepth = 64 };
+
+    JsonReader( const char* data, size_t size )
+      : m_Cursor( data ), m_End( data + size ), m_Failed( false ), m_KeyLength( 0 )
+    {
+    }
+
+    bool IsOk() const
+    {
+      return !m_Failed;
+    }
+
+    // Marks the input as invalid, all reads fail from here on.
+    bool Fail()
+    {
+      m_Failed = true;
+      m_Cursor = m_End;
+      return false;
+    }
+
+    bool IsAtEnd()
+    {
+      SkipWhitespace();
+      return !m_Failed && m_Cursor == m_End;
+    }
+
+    bool BeginObject()
+    {
+      return Expect( '{' );
+    }
+
+    // Reads the next key of the current object and the colon after it, and
+    // returns its hash. Returns false at the closing brace or on errors; first
+    // must be true before the first call for each object.
+    bool NextKey( uint32_t& hash, bool& first )
+    {
+      SkipWhitespace();
+
+      if ( m_Cursor == m_End )
+      {
+        return Fail();
+      }
+
+      if ( *m_Cursor == '}' )
+      {
+        m_Cursor++;
+        return false;
+      }
+
+      if ( !first && !Expect( ',' ) )
+      {
+        return false;
+      }
+
+      first = false;
+      return ReadHashed( hash ) && Expect( ':' );
+    }
+
+    // Reads a string and returns its hash, i.e. a select value.
+    bool ReadHashed( uint32_t& hash )
+    {
+      SkipWhitespace();
+
+      if ( m_Cursor == m_End || *m_Cursor != '"' )
+      {
+        return Fail();
+      }
+
+      const unsigned char* in  = (const unsigned char*)m_Cursor + 1;
+      const unsigned char* end = (const unsigned char*)m_End;
+
+      uint32_t crc = 0xEDB88320U;
+      m_KeyLength  = 0;
+
+      for ( ;; )
+      {
+        if ( in == end || *in < 0x20 )
+        {
+          return Fail();
+        }
+
+        char   decoded[ 4 ];
+        size_t count = 1;
+        decoded[ 0 ] = (char)*in++;
+
+        if ( decoded[ 0 ] == '"' )
+        {
+          break;
+        }
+        else if ( decoded[ 0 ] == '\\' && !DecodeEscape( in, end, decoded, count ) )
+        {
+          return Fail();
+        }
+
+        for ( size_t i = 0; i < count; i++ )
+        {
+          crc = ( crc >> 8 ) ^ Crc32Table()[ (uint8_t)decoded[ i ] ^ ( crc & 0xff ) ];
+
+          if ( m_KeyLength < kMaxKeyLength )
+          {
+            m_Key[ m_KeyLength ] = decoded[ i ];
+          }
+
+          m_KeyLength++;
+        }
+      }
+
+      // StringCrc32 returns zero for empty strings.
+      hash     = m_KeyLength != 0 ? crc : 0;
+      m_Cursor = (const char*)in;
+      return true;
+    }
+
+    // Checks the text of the last key or string read by ReadHashed.
+    bool Matches( const char* text, size_t length ) const
+    {
+      return length == m_KeyLength && length <= kMaxKeyLength && memcmp( m_Key, text, length ) == 0;
+    }
+
+    bool Read( bool& value )
+    {
+      SkipWhitespace();
+
+      if ( Literal( "true", 4 ) )
+      {
+        value = true;
+        return true;
+      }
+      else if ( Literal( "false", 5 ) )
+      {
+        value = false;
+        return true;
+      }
+
+      return Fail();
+    }
+    bool Read( uint8_t& value )  { return ReadUnsigned( value, 0xffU ); }
+    bool Read( uint16_t& value ) { return ReadUnsigned( value, 0xffffU ); }
+    bool Read( uint32_t& value ) { return ReadUnsigned( value, 0xffffffffU ); }
+    bool Read( uint64_t& value ) { return ReadUnsigned( value, ~(uint64_t)0 ); }
+    bool Read( int8_t& value )   { return ReadSigned( value, 0x7f ); }
+    bool Read( int16_t& value )  { return ReadSigned( value, 0x7fff ); }
+    bool Read( int32_t& value )  { return ReadSigned( value, 0x7fffffff ); }
+    bool Read( int64_t& value )  { return ReadSigned( value, ~(uint64_t)0 >> 1 ); }
+    bool Read( double& value )
+    {
+      return ReadFloating( value );
+    }
+    bool Read( float& value )
+    {
+      return ReadFloating( value );
+    }
+    bool Read( std::string& value )
+    {
+      SkipWhitespace();
+
+      if ( m_Cursor == m_End || *m_Cursor != '"' )
+      {
+        return Fail();
+      }
+
+      const unsigned char* in  = (const unsigned char*)m_Cursor + 1;
+      const unsigned char* end = (const unsigned char*)m_End;
+
+      value.clear();
+
+      for ( ;; )
+      {
+        const unsigned char* run = in;
+
+        while ( in < end && *in >= 0x20 && *in != '"' && *in != '\\' )
+        {
+          in++;
+        }
+
+        value.append( (const char*)run, in - run );
+
+        if ( in == end || *in < 0x20 )
+        {
+          return Fail();
+        }
+        else if ( *in++ == '"' )
+        {
+          break;
+        }
+
+        char   decoded[ 4 ];
+        size_t count;
+
+        if ( !DecodeEscape( in, end, decoded, count ) )
+        {
+          return Fail();
+        }
+
+        value.append( decoded, count );
+      }
+
+      m_Cursor = (const char*)in;
+      return true;
+    }
+
+    // Skips over the next value, including any objects or arrays in it.
+    bool SkipValue()
+    {
+      // One bit per open container, set for objects.
+      uint64_t objects = 0;
+      int      depth   = 0;
+
+      do
+      {
+        SkipWhitespace();
+
+        if ( m_Cursor == m_End )
+        {
+          return Fail();
+        }
+
+        char c = *m_Cursor;
+
+        if ( c == '{' || c == '[' )
+        {
+          if ( depth == kMaxSkipDepth )
+          {
+            return Fail();
+          }
+
+          objects = ( objects << 1 ) | ( c == '{' );
+          depth++;
+          m_Cursor++;
+        }
+        else if ( c == '}' || c == ']' )
+        {
+          if ( depth == 0 || ( objects & 1 ) != ( c == '}' ) )
+          {
+            return Fail();
+          }
+
+          objects >>= 1;
+          depth--;
+          m_Cursor++;
+        }
+        else if ( c == ',' || c == ':' )
+        {
+          if ( depth == 0 )
+          {
+            return Fail();
+          }
+
+          m_Cursor++;
+        }
+        else if ( c == '"' )
+        {
+          uint32_t hash;
+
+          if ( !ReadHashed( hash ) )
+          {
+            return false;
+          }
+        }
+        else
+        {
+          const char* start = m_Cursor;
+
+          while ( m_Cursor < m_End && IsScalarChar( *m_Cursor ) )
+          {
+            m_Cursor++;
+          }
+
+          if ( m_Cursor == start )
+          {
+            return Fail();
+          }
+        }
+      }
+      while ( depth != 0 );
+
+      return true;
+    }
+
+  private:
+    void SkipWhitespace()
+    {
+      while ( m_Cursor < m_End && ( *m_Cursor == ' ' || *m_Cursor == '\n' || *m_Cursor == '\r' || *m_Cursor == '\t' ) )
+      {
+        m_Cursor++;
+      }
+    }
+
+    bool Expect( char c )
+    {
+      SkipWhitespace();
+
+      if ( m_Cursor == m_End || *m_Cursor != c )
+      {
+        return Fail();
+      }
+
+      m_Cursor++;
+      return true;
+    }
+
+    bool Literal( const char* text, size_t length )
+    {
+      if ( (size_t)( m_End - m_Cursor ) >= length && memcmp( m_Cursor, text, length ) == 0 )
+      {
+        m_Cursor += length;
+        return true;
+      }
+
+      return false;
+    }
+
+    static bool IsScalarChar( char c )
+    {
+      return ( c >= '0' && c <= '9' ) || ( c >= 'a' && c <= 'z' ) || c == '-' || c == '+' || c == '.' || c == 'E';
+    }
+
+    // Parses the digits of an integer, failing if it doesn't fit in max.
+    bool ReadDigits( uint64_t& value, uint64_t max )
+    {
+      const char* start = m_Cursor;
+      value = 0;
+
+      while ( m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9' )
+      {
+        unsigned digit = *m_Cursor++ - '0';
+
+        if ( value > ( max - digit ) / 10 )
+        {
+          return Fail();
+        }
+
+        value = value * 10 + digit;
+      }
+
+      // No digits, leading zeros, or a fraction or exponent.
+      if ( m_Cursor == start || ( *start == '0' && m_Cursor - start > 1 ) )
+      {
+        return Fail();
+      }
+      else if ( m_Cursor < m_End && ( *m_Cursor == '.' || *m_Cursor == 'e' || *m_Cursor == 'E' ) )
+      {
+        return Fail();
+      }
+
+      return true;
+    }
+
+    template< typename T >
+    bool ReadUnsigned( T& value, uint64_t max )
+    {
+      SkipWhitespace();
+      uint64_t digits;
+
+      if ( !ReadDigits( digits, max ) )
+      {
+        return false;
+      }
+
+      value = (T)digits;
+      return true;
+    }
+
+    template< typename T >
+    bool ReadSigned( T& value, uint64_t max )
+    {
+      SkipWhitespace();
+      bool negative = m_Cursor < m_End && *m_Cursor == '-';
+      uint64_t digits;
+
+      if ( negative )
+      {
+        m_Cursor++;
+      }
+
+      if ( !ReadDigits( digits, negative ? max + 1 : max ) )
+      {
+        return false;
+      }
+
+      value = negative ? (T)( 0 - digits ) : (T)digits;
+      return true;
+    }
+
+    // Non-finite values are written as null, read them back as NaN.
+    template< typename T >
+    bool ReadFloating( T& value )
+    {
+      SkipWhitespace();
+
+      if ( Literal( "null", 4 ) )
+      {
+        value = (T)strtod( "nan", NULL );
+        return true;
+      }
+
+      const char* start = m_Cursor;
+
+      while ( m_Cursor < m_End && IsScalarChar( *m_Cursor ) )
+      {
+        m_Cursor++;
+      }
+
+      // Rule out the infinities and NaNs both parsers accept.
+      const char* digits = start + ( m_Cursor > start && *start == '-' );
+
+      if ( digits == m_Cursor || *digits < '0' || *digits > '9' )
+      {
+        return Fail();
+      }
+
+#ifdef JSON_READ_FROM_CHARS
+      std::from_chars_result result = std::from_chars( start, m_Cursor, value );
+
+      if ( result.ec != std::errc() || result.ptr != m_Cursor )
+      {
+        return Fail();
+      }
+#else
+      char   number[ 64 ];
+      size_t length = m_Cursor - start;
+      char*  end;
+
+      if ( length >= sizeof( number ) )
+      {
+        return Fail();
+      }
+
+      memcpy( number, start, length );
+      number[ length ] = 0;
+      value = (T)strtod( number, &end );
+
+      if ( end != number + length )
+      {
+        return Fail();
+      }
+#endif
+
+      return true;
+    }
+
+    static int HexDigit( unsigned char c )
+    {
+      if ( c >= '0' && c <= '9' ) return c - '0';
+      if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+      if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+      return -1;
+    }
+
+    static bool ReadHex4( const unsigned char*& in, const unsigned char* end, uint32_t& code )
+    {
+      if ( end - in < 4 )
+      {
+        return false;
+      }
+
+      code = 0;
+
+      for ( int i = 0; i < 4; i++ )
+      {
+        int digit = HexDigit( *in++ );
+
+        if ( digit < 0 )
+        {
+          return false;
+        }
+
+        code = code << 4 | digit;
+      }
+
+      return true;
+    }
+
+    // Decodes the escape sequence after a backslash into up to four UTF-8 bytes.
+    static bool DecodeEscape( const unsigned char*& in, const unsigned char* end, char decoded[ 4 ], size_t& count )
+    {
+      if ( in == end )
+      {
+        return false;
+      }
+
+      count = 1;
+
+      switch ( *in++ )
+      {
+        case '"':  decoded[ 0 ] = '"'; return true;
+        case '\\': decoded[ 0 ] = '\\'; return true;
+        case '/':  decoded[ 0 ] = '/'; return true;
+        case 'b':  decoded[ 0 ] = '\b'; return true;
+        case 'f':  decoded[ 0 ] = '\f'; return true;
+        case 'n':  decoded[ 0 ] = '\n'; return true;
+        case 'r':  decoded[ 0 ] = '\r'; return true;
+        case 't':  decoded[ 0 ] = '\t'; return true;
+        case 'u':  break;
+        default:   return false;
+      }
+
+      uint32_t code;
+
+      if ( !ReadHex4( in, end, code ) || ( code >= 0xdc00 && code <= 0xdfff ) )
+      {
+        return false;
+      }
+
+      if ( code >= 0xd800 && code <= 0xdbff )
+      {
+        uint32_t low;
+
+        if ( end - in < 2 || in[ 0 ] != '\\' || in[ 1 ] != 'u' )
+        {
+          return false;
+        }
+
+        in += 2;
+
+        if ( !ReadHex4( in, end, low ) || low < 0xdc00 || low > 0xdfff )
+        {
+          return false;
+        }
+
+        code = 0x10000 + ( ( code - 0xd800 ) << 10 ) + ( low - 0xdc00 );
+      }
+
+      if ( code < 0x80 )
+      {
+        decoded[ 0 ] = (char)code;
+      }
+      else if ( code < 0x800 )
+      {
+        decoded[ 0 ] = (char)( 0xc0 | code >> 6 );
+        decoded[ 1 ] = (char)( 0x80 | ( code & 0x3f ) );
+        count = 2;
+      }
+      else if ( code < 0x10000 )
+      {
+        decoded[ 0 ] = (char)( 0xe0 | code >> 12 );
+        decoded[ 1 ] = (char)( 0x80 | ( code >> 6 & 0x3f ) );
+        decoded[ 2 ] = (char)( 0x80 | ( code & 0x3f ) );
+        count = 3;
+      }
+      else
+      {
+        decoded[ 0 ] = (char)( 0xf0 | code >> 18 );
+        decoded[ 1 ] = (char)( 0x80 | ( code >> 12 & 0x3f ) );
+        decoded[ 2 ] = (char)( 0x80 | ( code >> 6 & 0x3f ) );
+        decoded[ 3 ] = (char)( 0x80 | ( code & 0x3f ) );
+        count = 4;
+      }
+
+      return true;
+    }
+
+    // Same table as DDLParser::StringCrc32, seeded with 0xEDB88320.
+    static const uint32_t* Crc32Table()
+    {
+      static const uint32_t table[] =
+      {
+        0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA,
+        0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+        0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
+        0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+        0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE,
+        0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+        0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC,
+        0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+        0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
+        0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+        0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940,
+        0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+        0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116,
+        0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+        0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
+        0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+        0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A,
+        0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+        0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818,
+        0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+        0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
+        0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+        0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C,
+        0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+        0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2,
+        0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+        0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
+        0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+        0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086,
+        0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+        0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4,
+        0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+        0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
+        0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+        0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8,
+        0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+        0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE,
+        0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+        0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
+        0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+        0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252,
+        0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+        0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60,
+        0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+        0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
+        0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+        0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04,
+        0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+        0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A,
+        0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+        0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
+        0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+        0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E,
+        0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+        0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C,
+        0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+        0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
+        0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+        0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0,
+        0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+        0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6,
+        0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+        0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
+        0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
+      };
+
+      return table;
+    }
+
+    const char* m_Cursor;
+    const char* m_End;
+    bool        m_Failed;
+    char        m_Key[ kMaxKeyLength ];
+    size_t      m_KeyLength;
+};
@@ -1,16 +1,147 @@
 #pragma once
 
-// Scope-based utility for writing JSON data to character buffer
+// Scope-based utility for writing JSON data to a character buffer
 // Designed to be super simple to use and not carry any actual JSON parsing overhead.
+//
+// Keys are passed in already quoted and escaped together with their length
+// (e.g. "\"Health\": ", 10), so writing a field is a single bounds check followed
+// by a couple of copies. Integers are formatted by hand, and floating point values
+// are written with the shortest representation that reads back to the same value
+// when std::to_chars is available, and with enough digits to read back the same
+// value otherwise.
 
-// Requires: size_t
-// Requires: sprintf
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#if __cplusplus >= 201703L && defined( __has_include )
+  #if __has_include( <charconv> )
+    #include <charconv>
+  #endif
+#endif
+
+#if defined( __cpp_lib_to_chars ) && __cpp_lib_to_chars >= 201611L
+  #define JSON_WRITE_TO_CHARS 1
+#endif
+
+// Output buffer for the scopes below. It grows as needed, or wraps a fixed
+// buffer which is never written past its end. Once a write doesn't fit, the
+// buffer is marked as failed and ignores all further writes.
+
+class JsonBuffer
+{
+  public:
+    JsonBuffer()
+      : m_Data( NULL ), m_Size( 0 ), m_Capacity( 0 ), m_Owned( true ), m_Failed( false )
+    {
+    }
+    JsonBuffer( char* data, size_t capacity )
+      : m_Data( data ), m_Size( 0 ), m_Capacity( capacity ), m_Owned( false ), m_Failed( false )
+    {
+    }
+    ~JsonBuffer()
+    {
+      if ( m_Owned )
+      {
+        free( m_Data );
+      }
+    }
+
+    const char* GetData() const { return m_Data; }
+    size_t      GetSize() const { return m_Size; }
+    bool        IsOk() const    { return !m_Failed; }
+
+    void Clear()
+    {
+      m_Size   = 0;
+      m_Failed = false;
+    }
+
+    // Returns a pointer to at least size writable bytes, or NULL if they
+    // can't be had. Finish the write with Commit.
+    char* Reserve( size_t size )
+    {
+      if ( size <= m_Capacity - m_Size && !m_Failed )
+      {
+        return m_Data + m_Size;
+      }
+
+      return Grow( size );
+    }
+    void Commit( char* end )
+    {
+      m_Size = end - m_Data;
+    }
+
+    void Append( const char* data, size_t size )
+    {
+      char* out = Reserve( size );
+
+      if ( out )
+      {
+        memcpy( out, data, size );
+        m_Size += size;
+      }
+    }
+    void Append( char c )
+    {
+      char* out = Reserve( 1 );
+
+      if ( out )
+      {
+        *out = c;
+        m_Size++;
+      }
+    }
+
+  private:
+    JsonBuffer( const JsonBuffer& );
+    JsonBuffer& operator=( const JsonBuffer& );
+
+    char* Grow( size_t size )
+    {
+      if ( m_Failed || !m_Owned || size > (size_t)-1 / 2 - m_Size )
+      {
+        m_Failed = true;
+        return NULL;
+      }
+
+      size_t capacity = m_Capacity < 256 ? 256 : m_Capacity;
+
+      while ( capacity - m_Size < size )
+      {
+        capacity *= 2;
+      }
+
+      char* data = (char*)realloc( m_Data, capacity );
+
+      if ( !data )
+      {
+        m_Failed = true;
+        return NULL;
+      }
+
+      m_Data     = data;
+      m_Capacity = capacity;
+      return m_Data + m_Size;
+    }
+
+    char*  m_Data;
+    size_t m_Size;
+    size_t m_Capacity;
+    bool   m_Owned;
+    bool   m_Failed;
+};
 
 class JsonWriteScope
 {
   public:
-    JsonWriteScope( char*& output, size_t& output_size )
-      : m_Output(output), m_OutputSize(output_size), m_FirstElement(true)
+    // Room for the longest number, with or without a sign, or "false".
+    enum { kMaxValueSize = 32 };
+
+    JsonWriteScope( JsonBuffer& buffer )
+      : m_Buffer( buffer ), m_FirstElement( true )
     {
     }
     ~JsonWriteScope()
@@ -19,168 +150,279 @@ class JsonWriteScope
 
     void WriteComma()
     {
-      if (!m_FirstElement)
+      if ( !m_FirstElement )
       {
-        m_Output[0] = ',';
-        m_OutputSize++;
-        m_Output++;
+        m_Buffer.Append( ',' );
       }
       else
       {
         m_FirstElement = false;
       }
     }
-    void WriteDouble( double value, const char* name = NULL )
+    void WriteKey( const char* key, size_t key_length )
     {
       WriteComma();
 
-      if ( name )
+      if ( key_length )
       {
-        int out_size = sprintf( m_Output, "\"%s\": %g", name, value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        m_Buffer.Append( key, key_length );
       }
-      else
+    }
+    void WriteDouble( double value, const char* key = NULL, size_t key_length = 0 )
+    {
+      char* out = Begin( key, key_length, kMaxValueSize );
+
+      if ( out )
       {
-        int out_size = sprintf( m_Output, "%g", value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        m_Buffer.Commit( FormatDouble( out, value ) );
       }
     }
-    void WriteFloat( float value, const char* name = NULL )
+    void WriteFloat( float value, const char* key = NULL, size_t key_length = 0 )
     {
-      WriteDouble( value, name );
+      char* out = Begin( key, key_length, kMaxValueSize );
+
+      if ( out )
+      {
+        m_Buffer.Commit( FormatFloat( out, value ) );
+      }
     }
-    void WriteUInt( unsigned int value, const char* name = NULL )
+    void WriteUInt( uint64_t value, const char* key = NULL, size_t key_length = 0 )
     {
-      WriteComma();
+      char* out = Begin( key, key_length, kMaxValueSize );
 
-      if ( name )
+      if ( out )
       {
-        int out_size = sprintf( m_Output, "\"%s\": %u", name, value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        m_Buffer.Commit( FormatUInt( out, value ) );
       }
-      else
+    }
+    void WriteInt( int64_t value, const char* key = NULL, size_t key_length = 0 )
+    {
+      char* out = Begin( key, key_length, kMaxValueSize );
+
+      if ( out )
       {
-        int out_size = sprintf( m_Output, "%u", value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        m_Buffer.Commit( FormatInt( out, value ) );
       }
     }
-    void WriteInt( unsigned int value, const char* name = NULL )
+    void WriteString( const char* value, size_t length, const char* key = NULL, size_t key_length = 0 )
     {
-      WriteComma();
+      // Worst case every character becomes a \u00XX escape.
+      if ( length > ( (size_t)-1 - key_length ) / 6 - 3 )
+      {
+        m_Buffer.Reserve( (size_t)-1 );
+        return;
+      }
+
+      char* out = Begin( key, key_length, length * 6 + 2 );
 
-      if ( name )
+      if ( out )
       {
-        int out_size = sprintf( m_Output, "\"%s\": %d", name, value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        m_Buffer.Commit( FormatString( out, value, length ) );
       }
-      else
+    }
+    void WriteString( const char* value, const char* key = NULL, size_t key_length = 0 )
+    {
+      WriteString( value, strlen( value ), key, key_length );
+    }
+    void WriteBool( bool value, const char* key = NULL, size_t key_length = 0 )
+    {
+      WriteLiteral( value ? "true" : "false", value ? 4 : 5, key, key_length );
+    }
+    // Writes a value which is already valid JSON, i.e. a quoted select item.
+    void WriteLiteral( const char* json, size_t length, const char* key = NULL, size_t key_length = 0 )
+    {
+      char* out = Begin( key, key_length, length );
+
+      if ( out )
       {
-        int out_size = sprintf( m_Output, "%d", value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        memcpy( out, json, length );
+        m_Buffer.Commit( out + length );
       }
     }
-    void WriteString( const char* value, const char* name = NULL )
+
+    static char* FormatUInt( char* out, uint64_t value )
     {
-      WriteComma();
+      static const char digit_pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+      char  digits[ 20 ];
+      char* end   = digits + sizeof( digits );
+      char* start = end;
+
+      while ( value >= 100 )
+      {
+        const char* pair = digit_pairs + ( value % 100 ) * 2;
+        value /= 100;
+        start -= 2;
+        start[ 0 ] = pair[ 0 ];
+        start[ 1 ] = pair[ 1 ];
+      }
 
-      if ( name )
+      if ( value >= 10 )
       {
-        int out_size = sprintf( m_Output, "\"%s\": \"%s\"", name, value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        const char* pair = digit_pairs + value * 2;
+        start -= 2;
+        start[ 0 ] = pair[ 0 ];
+        start[ 1 ] = pair[ 1 ];
       }
       else
       {
-        int out_size = sprintf( m_Output, "\"%s\"", value );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        *--start = (char)( '0' + value );
       }
+
+      memcpy( out, start, end - start );
+      return out + ( end - start );
     }
-    void WriteBool( bool value, const char* name = NULL )
+    static char* FormatInt( char* out, int64_t value )
     {
-      WriteComma();
+      if ( value < 0 )
+      {
+        *out++ = '-';
+        return FormatUInt( out, 0 - (uint64_t)value );
+      }
 
-      if ( name )
+      return FormatUInt( out, (uint64_t)value );
+    }
+    // JSON has no representation for infinities and NaNs, they're written as null.
+    static char* FormatDouble( char* out, double value )
+    {
+      if ( !( value - value == 0 ) )
       {
-        int out_size = sprintf( m_Output, "\"%s\": %s", name, (value)?"true":"false" );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        memcpy( out, "null", 4 );
+        return out + 4;
       }
-      else
+
+#ifdef JSON_WRITE_TO_CHARS
+      return std::to_chars( out, out + kMaxValueSize, value ).ptr;
+#else
+      // Without to_chars, 17 significant digits (9 for floats) always read
+      // back the same value, though they aren't always the shortest.
+      return out + sprintf( out, "%.17g", value );
+#endif
+    }
+    static char* FormatFloat( char* out, float value )
+    {
+      if ( !( value - value == 0 ) )
       {
-        int out_size = sprintf( m_Output, "%s", (value)?"true":"false" );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        memcpy( out, "null", 4 );
+        return out + 4;
       }
+
+#ifdef JSON_WRITE_TO_CHARS
+      return std::to_chars( out, out + kMaxValueSize, value ).ptr;
+#else
+      return out + sprintf( out, "%.9g", value );
+#endif
     }
-    char*&  m_Output;
-    size_t& m_OutputSize;
-    bool    m_FirstElement;
-};
+    static char* FormatString( char* out, const char* value, size_t length )
+    {
+      static const char hex[] = "0123456789abcdef";
 
-class JsonWriteScopeObject : public JsonWriteScope
-{
-  public:
-    JsonWriteScopeObject( JsonWriteScope* parent_scope, const char* name = NULL )
-      : JsonWriteScope( parent_scope->m_Output, parent_scope->m_OutputSize )
+      const unsigned char* in  = (const unsigned char*)value;
+      const unsigned char* end = in + length;
+
+      *out++ = '"';
+
+      while ( in < end )
+      {
+        const unsigned char* run = in;
+
+        while ( in < end && *in >= 0x20 && *in != '"' && *in != '\\' )
+        {
+          in++;
+        }
+
+        memcpy( out, run, in - run );
+        out += in - run;
+
+        if ( in == end )
+        {
+          break;
+        }
+
+        unsigned char c = *in++;
+        *out++ = '\\';
+
+        switch ( c )
+        {
+          case '"':  *out++ = '"'; break;
+          case '\\': *out++ = '\\'; break;
+          case '\n': *out++ = 'n'; break;
+          case '\r': *out++ = 'r'; break;
+          case '\t': *out++ = 't'; break;
+          case '\b': *out++ = 'b'; break;
+          case '\f': *out++ = 'f'; break;
+          default:
+            memcpy( out, "u00", 3 );
+            out[ 3 ] = hex[ c >> 4 ];
+            out[ 4 ] = hex[ c & 15 ];
+            out += 5;
+            break;
+        }
+      }
+
+      *out++ = '"';
+      return out;
+    }
+
+    JsonBuffer& m_Buffer;
+    bool        m_FirstElement;
+
+  private:
+    // Writes the separator and the key, and reserves room for the value.
+    char* Begin( const char* key, size_t key_length, size_t value_size )
     {
-      parent_scope->WriteComma();
+      char* out = m_Buffer.Reserve( key_length + value_size + 1 );
 
-      if ( name )
+      if ( !out )
       {
-        int out_size = sprintf( m_Output, "\"%s\": {", name );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
+        return NULL;
       }
-      else
+
+      if ( !m_FirstElement )
       {
-        m_Output[0] = '{';
-        m_OutputSize++;
-        m_Output++;
+        *out++ = ',';
       }
 
+      m_FirstElement = false;
+
+      if ( key_length )
+      {
+        memcpy( out, key, key_length );
+      }
+
+      return out + key_length;
+    }
+};
+
+class JsonWriteScopeObject : public JsonWriteScope
+{
+  public:
+    JsonWriteScopeObject( JsonWriteScope* parent_scope, const char* key = NULL, size_t key_length = 0 )
+      : JsonWriteScope( parent_scope->m_Buffer )
+    {
+      parent_scope->WriteKey( key, key_length );
+      m_Buffer.Append( '{' );
     }
     ~JsonWriteScopeObject()
     {
-      m_Output[0] = '}';
-      m_OutputSize++;
-      m_Output++;
+      m_Buffer.Append( '}' );
     }
 };
 
 class JsonWriteScopeArray : public JsonWriteScope
 {
   public:
-    JsonWriteScopeArray( JsonWriteScope* parent_scope, const char* name = NULL )
-      : JsonWriteScope( parent_scope->m_Output, parent_scope->m_OutputSize )
+    JsonWriteScopeArray( JsonWriteScope* parent_scope, const char* key = NULL, size_t key_length = 0 )
+      : JsonWriteScope( parent_scope->m_Buffer )
     {
-      parent_scope->WriteComma();
-
-      if ( name )
-      {
-        int out_size = sprintf( m_Output, "\"%s\": [", name );
-        m_Output     += out_size;
-        m_OutputSize += out_size;
-      }
-      else
-      {
-        m_Output[0] = '{';
-        m_OutputSize++;
-        m_Output++;
-      }
-
+      parent_scope->WriteKey( key, key_length );
+      m_Buffer.Append( '[' );
     }
     ~JsonWriteScopeArray()
     {
-      m_Output[0] = ']';
-      m_OutputSize++;
-      m_Output++;
+      m_Buffer.Append( ']' );
     }
 };
-
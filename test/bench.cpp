@@ -0,0 +1,1031 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <DDLParser.h>
+
+#if defined( TEST_VARINT )
+#include "test_varint_ddl.h"
+#include "test_varint_view_ddl.h"
+#elif defined( TEST_DIRTY )
+#include "test_dirty_ddl.h"
+#include "test_dirty_view_ddl.h"
+#elif defined( TEST_UNORDERED )
+#include "test_unordered_ddl.h"
+#include "test_unordered_view_ddl.h"
+#elif defined( TEST_FLAT )
+#include "test_flat_ddl.h"
+#include "test_flat_view_ddl.h"
+#else
+#include "test_ddl.h"
+#include "test_view_ddl.h"
+#endif
+#include "test_soa_ddl.h"
+#include "bench_select_ddl.h"
+
+// Number of records saved and loaded by each benchmark.
+#define NUM_RECORDS 200000
+
+// Number of elements in the array saved and loaded by the large array benchmark.
+#define NUM_ELEMENTS 1000000
+
+// Number of steps taken by the position integration benchmark.
+#define NUM_STEPS 100
+
+class BenchAllocator: public DDLParser::LinearAllocator
+{
+private:
+  char*  m_Base;
+  size_t m_MaxSizeInBytes;
+  size_t m_CurrentOffset;
+
+public:
+  bool Init( size_t max_size_in_bytes )
+  {
+    m_Base = (char*)malloc( max_size_in_bytes );
+    m_MaxSizeInBytes = max_size_in_bytes;
+    m_CurrentOffset = 0;
+    return m_Base != 0;
+  }
+
+  void Destroy()
+  {
+    free( m_Base );
+  }
+
+  void* Allocate( size_t size_in_bytes, size_t alignment_in_bytes = 1 )
+  {
+    size_t offset = ( m_CurrentOffset + alignment_in_bytes - 1 ) & ~( alignment_in_bytes - 1 );
+
+    if ( offset + size_in_bytes > m_MaxSizeInBytes )
+    {
+      return 0;
+    }
+
+    m_CurrentOffset = offset + size_in_bytes;
+    return m_Base + offset;
+  }
+
+  void* GetBase() const
+  {
+    return m_Base;
+  }
+
+  size_t GetCurrentOffset() const
+  {
+    return m_CurrentOffset;
+  }
+
+  void Reset()
+  {
+    m_CurrentOffset = 0;
+  }
+};
+
+// Mariner in the native layout used by the reflection serializer.
+struct NativePosition
+{
+  float x, y, angle;
+};
+
+struct NativeCompleted
+{
+  const char* key;
+  uint32_t    value;
+};
+
+struct NativeMariner
+{
+  uint32_t                health;
+  uint32_t                weapon;
+  uint32_t                powerup;
+  int32_t                 ammunition[ 8 ];
+  const char*             name;
+  NativePosition          position;
+  DDLParser::NativeArray  deaths;
+  DDLParser::NativeArray  completed;
+};
+
+static double Elapsed( clock_t start )
+{
+  return (double)( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+static void Report( const char* name, double seconds, long bytes, long records = NUM_RECORDS )
+{
+  printf( "%-28s %8.3f s %10.0f records/s %8.1f MB/s\n", name, seconds, records / seconds, bytes / seconds / ( 1024.0 * 1024.0 ) );
+}
+
+static char* ReadFile( const char* name, size_t* size )
+{
+  FILE* fp = fopen( name, "rb" );
+
+  if ( !fp )
+  {
+    return 0;
+  }
+
+  fseek( fp, 0, SEEK_END );
+  *size = ftell( fp );
+  fseek( fp, 0, SEEK_SET );
+  char* buffer = (char*)malloc( *size );
+
+  if ( buffer && fread( buffer, 1, *size, fp ) != *size )
+  {
+    free( buffer );
+    buffer = 0;
+  }
+
+  fclose( fp );
+  return buffer;
+}
+
+static bool BenchGenerated( Mariner& m1 )
+{
+  Mariner m2;
+  m2.Init();
+  FILE* fp = tmpfile();
+
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m1.Save( fp ) )
+    {
+      fprintf( stderr, "Failed to save mariner\n" );
+      return false;
+    }
+  }
+
+  fflush( fp );
+  long bytes = ftell( fp );
+  Report( "generated Save", Elapsed( start ), bytes );
+  rewind( fp );
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m2.Load( fp ) )
+    {
+      fprintf( stderr, "Failed to load mariner\n" );
+      return false;
+    }
+  }
+
+  Report( "generated Load", Elapsed( start ), bytes );
+  fclose( fp );
+  m2.Destroy();
+  return true;
+}
+
+static bool BenchBuffered( Mariner& m1 )
+{
+  Mariner m2;
+  m2.Init();
+  DDLWriter writer;
+
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m1.Save( writer ) )
+    {
+      fprintf( stderr, "Failed to save mariner\n" );
+      return false;
+    }
+  }
+
+  long bytes = (long)writer.GetSize();
+  Report( "generated buffered Save", Elapsed( start ), bytes );
+  printf( "%-28s %8ld bytes\n", "generated record size", bytes / NUM_RECORDS );
+  DDLReader reader( writer.GetData(), writer.GetSize() );
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m2.Load( reader ) )
+    {
+      fprintf( stderr, "Failed to load mariner\n" );
+      return false;
+    }
+  }
+
+  Report( "generated buffered Load", Elapsed( start ), bytes );
+  bool ok = m2.GetDeathsCount() == m1.GetDeathsCount() && m2.GetCompleted( "E1M2" ) == 50;
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Data does not match\n" );
+  }
+
+  return ok;
+}
+
+// Saves indexed records, and loads two fields from each one, skipping the
+// arrays and the hashmap.
+static bool BenchIndexed( Mariner& m1 )
+{
+  Mariner m2;
+  m2.Init();
+  DDLWriter writer;
+
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m1.SaveIndexed( writer ) )
+    {
+      fprintf( stderr, "Failed to save mariner\n" );
+      return false;
+    }
+  }
+
+  long bytes = (long)writer.GetSize();
+  Report( "generated SaveIndexed", Elapsed( start ), bytes );
+  DDLReader reader( writer.GetData(), writer.GetSize() );
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m2.LoadFields( reader, Mariner::kHealthField | Mariner::kNameField ) )
+    {
+      fprintf( stderr, "Failed to load mariner\n" );
+      return false;
+    }
+  }
+
+  Report( "LoadFields of 2 fields", Elapsed( start ), bytes );
+  bool ok = m2.GetName() == m1.GetName() && m2.GetDeathsCount() == 0;
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Data does not match\n" );
+  }
+
+  return ok;
+}
+
+// Writes records with an appender, and scans them sequentially from the
+// mapped file, loading or just skipping each one.
+static bool BenchStream( Mariner& m1 )
+{
+  const char* name = "bench_stream.dat";
+  Mariner m2;
+  m2.Init();
+  remove( name );
+  MarinerAppender appender;
+  bool ok = appender.Open( name );
+
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS && ok; i++ )
+  {
+    ok = appender.Append( m1 );
+  }
+
+  ok = ok && appender.Close();
+  Report( "stream Append", Elapsed( start ), (long)( NUM_RECORDS * ( sizeof( size_t ) + m1.GetSerializedSize() ) ) );
+  MarinerStreamReader stream;
+  ok = ok && stream.Open( name );
+  int count = 0;
+  start = clock();
+
+  while ( ok && stream.Next( m2 ) )
+  {
+    count++;
+  }
+
+  Report( "stream Next", Elapsed( start ), (long)( NUM_RECORDS * ( sizeof( size_t ) + m1.GetSerializedSize() ) ) );
+  ok = ok && count == NUM_RECORDS && stream.IsAtEnd() && stream.Open( name );
+  count = 0;
+  start = clock();
+
+  while ( ok && stream.Skip() )
+  {
+    count++;
+  }
+
+  Report( "stream Skip", Elapsed( start ), (long)( NUM_RECORDS * ( sizeof( size_t ) + m1.GetSerializedSize() ) ) );
+  ok = ok && count == NUM_RECORDS && m2.GetCompleted( "E1M2" ) == 50;
+  stream.Close();
+  remove( name );
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Failed to stream mariners\n" );
+  }
+
+  return ok;
+}
+
+// Reads two fields out of each record, decoding whole records with Load and
+// in place with views.
+static bool BenchView( Mariner& m1 )
+{
+  Mariner m2;
+  m2.Init();
+  DDLWriter writer, view_writer;
+  std::vector< size_t > tables;
+  tables.reserve( NUM_RECORDS );
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    tables.push_back( view_writer.GetSize() );
+
+    if ( !m1.Save( writer ) || !MarinerView::Save( m1, view_writer ) )
+    {
+      fprintf( stderr, "Failed to save mariner\n" );
+      return false;
+    }
+  }
+
+  DDLReader reader( writer.GetData(), writer.GetSize() );
+  long sum = 0;
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m2.Load( reader ) )
+    {
+      fprintf( stderr, "Failed to load mariner\n" );
+      return false;
+    }
+
+    sum += m2.GetHealth() + m2.GetCompleted( "E1M2" );
+  }
+
+  Report( "two fields with Load", Elapsed( start ), (long)writer.GetSize() );
+  const char* data = (const char*)view_writer.GetData();
+  long view_sum = 0;
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    MarinerView view( data + tables[ i ] );
+    view_sum += view.GetHealth() + view.GetCompletedValue( view.FindCompleted( "E1M2" ) );
+  }
+
+  Report( "two fields with a view", Elapsed( start ), (long)view_writer.GetSize() );
+  m2.Destroy();
+
+  if ( sum != view_sum )
+  {
+    fprintf( stderr, "Data does not match\n" );
+    return false;
+  }
+
+  return true;
+}
+
+// Hashes and compares records, the generated code handles runs of raw fields
+// with a single call.
+static bool BenchCompare( Mariner& m1 )
+{
+  Mariner m2;
+  m2.Init();
+  DDLWriter writer;
+  bool ok = m1.Save( writer );
+  DDLReader reader( writer.GetData(), writer.GetSize() );
+  ok = ok && m2.Load( reader );
+
+  uint64_t hash = 0;
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    hash += m2.Hash();
+  }
+
+  Report( "Hash", Elapsed( start ), (long)writer.GetSize() * NUM_RECORDS );
+  long equal = 0;
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    equal += m1 == m2;
+  }
+
+  Report( "operator==", Elapsed( start ), (long)writer.GetSize() * NUM_RECORDS );
+  ok = ok && equal == NUM_RECORDS && hash == m1.Hash() * NUM_RECORDS;
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Hashes do not match\n" );
+    return false;
+  }
+
+  return true;
+}
+
+// Moves particles by their speeds, over an array of structs and over a
+// structure of arrays. The loop only touches four of the eight fields.
+static bool BenchSoA()
+{
+  std::vector< Particle > particles( NUM_RECORDS );
+  ParticleSoA soa;
+  const float dt = 1.0f / 60.0f;
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    particles[ i ].Init();
+    particles[ i ].SetVx( (float)( i % 7 ) );
+    particles[ i ].SetVy( (float)( i % 11 ) );
+  }
+
+  if ( !soa.FromAoS( &particles[ 0 ], particles.size() ) )
+  {
+    fprintf( stderr, "Failed to convert particles\n" );
+    return false;
+  }
+
+  clock_t start = clock();
+
+  for ( int step = 0; step < NUM_STEPS; step++ )
+  {
+    for ( size_t i = 0; i < particles.size(); i++ )
+    {
+      Position& position = particles[ i ].GetPosition();
+      position.SetX( position.GetX() + particles[ i ].GetVx() * dt );
+      position.SetY( position.GetY() + particles[ i ].GetVy() * dt );
+    }
+  }
+
+  Report( "integrate AoS", Elapsed( start ), (long)sizeof( Particle ) * NUM_RECORDS * NUM_STEPS, (long)NUM_RECORDS * NUM_STEPS );
+
+  float* x = soa.GetPositionXColumn();
+  float* y = soa.GetPositionYColumn();
+  const float* vx = soa.GetVxColumn();
+  const float* vy = soa.GetVyColumn();
+  size_t count = soa.GetCount();
+  start = clock();
+
+  for ( int step = 0; step < NUM_STEPS; step++ )
+  {
+    for ( size_t i = 0; i < count; i++ )
+    {
+      x[ i ] += vx[ i ] * dt;
+      y[ i ] += vy[ i ] * dt;
+    }
+  }
+
+  Report( "integrate SoA", Elapsed( start ), (long)sizeof( float ) * 4 * NUM_RECORDS * NUM_STEPS, (long)NUM_RECORDS * NUM_STEPS );
+
+  bool ok = true;
+
+  for ( int i = 0; i < NUM_RECORDS && ok; i++ )
+  {
+    ok = fabs( x[ i ] - particles[ i ].GetPosition().GetX() ) < 0.001f && fabs( y[ i ] - particles[ i ].GetPosition().GetY() ) < 0.001f;
+  }
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    particles[ i ].Destroy();
+  }
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Particles do not match\n" );
+    return false;
+  }
+
+  return true;
+}
+
+// Saves a delta of a record each tick, changing its health and its position's
+// angle, and applies the deltas to another record. Only built with --dirty.
+static bool BenchDelta( const Mariner& record )
+{
+#ifdef TEST_DIRTY
+  Mariner m1 = record, m2 = record;
+  DDLWriter writer;
+  m1.ClearDirty();
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    m1.SetHealth( i );
+    m1.GetPosition().SetAngle( (float)i );
+
+    if ( !m1.SaveDelta( writer ) )
+    {
+      fprintf( stderr, "Failed to save delta\n" );
+      return false;
+    }
+
+    m1.ClearDirty();
+  }
+
+  long bytes = (long)writer.GetSize();
+  Report( "SaveDelta", Elapsed( start ), bytes );
+  printf( "%-28s %8ld bytes\n", "delta size", bytes / NUM_RECORDS );
+  DDLReader reader( writer.GetData(), writer.GetSize() );
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m2.ApplyDelta( reader ) )
+    {
+      fprintf( stderr, "Failed to apply delta\n" );
+      return false;
+    }
+  }
+
+  Report( "ApplyDelta", Elapsed( start ), bytes );
+  bool ok = m2 == m1;
+  m1.Destroy();
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Delta data does not match\n" );
+    return false;
+  }
+#else
+  (void)record;
+#endif
+
+  return true;
+}
+
+// Builds a vector of records by copying one in, then another by moving the
+// copies over. Moves also keep the vectors from copying the records as they grow.
+static bool BenchMove( Mariner& m1 )
+{
+#ifdef DDLT_CPP11
+  std::vector< Mariner > copies, moves;
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    copies.push_back( m1 );
+  }
+
+  Report( "build by copy", Elapsed( start ), 0 );
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    moves.push_back( std::move( copies[ i ] ) );
+  }
+
+  Report( "build by move", Elapsed( start ), 0 );
+  bool ok = moves.size() == NUM_RECORDS && moves.back() == m1;
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    copies[ i ].Destroy();
+    moves[ i ].Destroy();
+  }
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Moved data does not match\n" );
+    return false;
+  }
+#else
+  (void)m1;
+#endif
+
+  return true;
+}
+
+// Creates and frees short-lived records with new and delete, then with the
+// pool generated for structures tagged Pooled, which reuses the records and
+// the storage of their arrays and strings.
+static bool BenchPool( Mariner& m1 )
+{
+#ifdef DDLT_CPP11
+  clock_t start = clock();
+  size_t count = 0;
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    Mariner* m = new Mariner;
+    m->Init();
+    m->SetName( m1.GetName() );
+    m->AssignDeaths( &m1.GetDeaths( 0 ), &m1.GetDeaths( 0 ) + m1.GetDeathsCount() );
+    count += m->GetDeathsCount();
+    m->Destroy();
+    delete m;
+  }
+
+  Report( "new and delete", Elapsed( start ), 0 );
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    Mariner* m = Mariner::Acquire();
+    m->SetName( m1.GetName() );
+    m->AssignDeaths( &m1.GetDeaths( 0 ), &m1.GetDeaths( 0 ) + m1.GetDeathsCount() );
+    count -= m->GetDeathsCount();
+    Mariner::Release( m );
+  }
+
+  Report( "pool Acquire and Release", Elapsed( start ), 0 );
+  DDLPoolStats stats = Mariner::GetPoolStats();
+  Mariner::TrimPool( 0 );
+
+  if ( count != 0 || stats.misses != 1 || stats.hits != NUM_RECORDS - 1 )
+  {
+    fprintf( stderr, "Pooled data does not match\n" );
+    return false;
+  }
+#else
+  (void)m1;
+#endif
+
+  return true;
+}
+
+static bool BenchLargeArray()
+{
+  Mariner m1, m2;
+  m1.Init();
+  m2.Init();
+  Position p;
+
+  for ( int i = 0; i < NUM_ELEMENTS; i++ )
+  {
+    p.SetX( (float)i );
+    m1.AppendDeaths( p );
+  }
+
+  FILE* fp = tmpfile();
+  clock_t start = clock();
+  bool ok = m1.Save( fp );
+  fflush( fp );
+  long bytes = ftell( fp );
+  Report( "large array Save", Elapsed( start ), bytes, NUM_ELEMENTS );
+  rewind( fp );
+  start = clock();
+  ok = ok && m2.Load( fp );
+  Report( "large array Load", Elapsed( start ), bytes, NUM_ELEMENTS );
+  fclose( fp );
+
+  ok = ok && m2.GetDeathsCount() == NUM_ELEMENTS && m2.GetDeaths( NUM_ELEMENTS - 1 ).GetX() == NUM_ELEMENTS - 1;
+  m1.Destroy();
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Failed to save and load the large array\n" );
+  }
+
+  return ok;
+}
+
+static bool BenchHashmap( int count )
+{
+  Mariner m1, m2;
+  m1.Init();
+  m2.Init();
+  std::vector< std::string > keys( count );
+  char name[ 64 ];
+
+  for ( int i = 0; i < count; i++ )
+  {
+    sprintf( name, "level%d", (int)( ( i * 7919LL ) % count ) );
+    keys[ i ] = name;
+  }
+
+  // Insert in key order, as when loading, and look up in a scattered order.
+  std::vector< std::string > sorted( keys );
+  std::sort( sorted.begin(), sorted.end() );
+  sprintf( name, "hashmap %d insert", count );
+  clock_t start = clock();
+
+  for ( int i = 0; i < count; i++ )
+  {
+    m1.InsertCompleted( sorted[ i ], atoi( sorted[ i ].c_str() + 5 ) );
+  }
+
+  Report( name, Elapsed( start ), 0, count );
+  // Small maps are looked up several times to get measurable timings.
+  int rounds = count < NUM_ELEMENTS ? NUM_ELEMENTS / count : 1;
+  sprintf( name, "hashmap %d lookup", count );
+  uint32_t sum = 0;
+  start = clock();
+
+  for ( int round = 0; round < rounds; round++ )
+  {
+    for ( int i = 0; i < count; i++ )
+    {
+      sum += m1.GetCompleted( keys[ i ] );
+    }
+  }
+
+  Report( name, Elapsed( start ), 0, (long)count * rounds );
+
+  // Saving iterates over all the entries.
+  DDLWriter writer;
+  sprintf( name, "hashmap %d Save", count );
+  start = clock();
+  bool ok = m1.Save( writer );
+  Report( name, Elapsed( start ), (long)writer.GetSize(), count );
+  sprintf( name, "hashmap %d Load", count );
+  start = clock();
+  ok = ok && m2.Load( writer.GetData(), writer.GetSize() );
+  Report( name, Elapsed( start ), (long)writer.GetSize(), count );
+
+  ok = ok && m2.GetCompletedCount() == (size_t)count && sum == (uint32_t)( (uint64_t)count * ( count - 1 ) / 2 * rounds );
+  m1.Destroy();
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Failed to save and load the hashmap\n" );
+  }
+
+  return ok;
+}
+
+// Converts the names of select items to their values with the generated
+// FromName, and with Select::FindItem on the compiled definition. Every
+// select gets the same number of lookups, spread over all of its items.
+template< typename T >
+static bool BenchSelect( DDLParser::Definition* ddl, const char* name )
+{
+  DDLParser::Select* select = ddl->FindAggregate( name )->ToSelect();
+  size_t num_names = select->GetNumItems();
+  std::vector< const char* > names( num_names );
+  std::vector< size_t > lengths( num_names );
+
+  for ( size_t i = 0; i < num_names; i++ )
+  {
+    names[ i ] = ( *select )[ (unsigned)i ]->GetName();
+    lengths[ i ] = strlen( names[ i ] );
+  }
+
+  long rounds = (long)NUM_RECORDS * 8 / (long)num_names;
+  long lookups = rounds * (long)num_names;
+  uint32_t sum1 = 0, sum2 = 0;
+  char label[ 64 ];
+  clock_t start = clock();
+
+  for ( long i = 0; i < rounds; i++ )
+  {
+    for ( size_t j = 0; j < num_names; j++ )
+    {
+      sum1 += T::FromName( names[ j ], lengths[ j ] );
+    }
+  }
+
+  sprintf( label, "select FromName %u items", (unsigned)num_names );
+  Report( label, Elapsed( start ), 0, lookups );
+  start = clock();
+
+  for ( long i = 0; i < rounds; i++ )
+  {
+    for ( size_t j = 0; j < num_names; j++ )
+    {
+      sum2 += select->FindItem( names[ j ] )->GetNameHash();
+    }
+  }
+
+  sprintf( label, "Select::FindItem %u items", (unsigned)num_names );
+  Report( label, Elapsed( start ), 0, lookups );
+
+  if ( sum1 != sum2 )
+  {
+    fprintf( stderr, "Select values do not match\n" );
+    return false;
+  }
+
+  return true;
+}
+
+static bool BenchReflection( DDLParser::Definition* ddl, DDLParser::LinearAllocator* scratch )
+{
+  char error[ 256 ];
+  BenchAllocator program;
+  program.Init( 64 * 1024 );
+  DDLParser::Struct* structure = ddl->FindAggregate( "Mariner" )->ToStruct();
+  DDLParser::SerializerProgram* serializer = DDLParser::CompileSerializer( &program, scratch, ddl, structure, error, sizeof( error ) );
+
+  if ( !serializer )
+  {
+    fprintf( stderr, "%s\n", error );
+    return false;
+  }
+
+  DDLParser::NativeLayout layout = DDLParser::GetNativeLayout( ddl, structure );
+
+  if ( layout.m_Size != sizeof( NativeMariner ) )
+  {
+    fprintf( stderr, "NativeMariner doesn't match the native layout\n" );
+    return false;
+  }
+
+  NativeMariner m1, m2;
+  structure->GetDefaultImage()->Instantiate( &m1 );
+  NativePosition deaths[ 4 ] = { { 1, 2, 3 }, { 4, 5, 6 }, { 7, 8, 9 }, { 10, 11, 12 } };
+  NativeCompleted completed[ 2 ] = { { "E1M1", 100 }, { "E1M2", 50 } };
+  m1.deaths.m_Elements = deaths;
+  m1.deaths.m_Count = 4;
+  m1.completed.m_Elements = completed;
+  m1.completed.m_Count = 2;
+
+  char buffer[ 1024 ];
+  FILE* fp = tmpfile();
+
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    size_t size = DDLParser::Serialize( serializer, &m1, buffer, sizeof( buffer ) );
+    fwrite( buffer, 1, size, fp );
+  }
+
+  fflush( fp );
+  long bytes = ftell( fp );
+  Report( "reflection Serialize", Elapsed( start ), bytes );
+
+  char* data = (char*)malloc( bytes );
+  rewind( fp );
+
+  if ( fread( data, 1, bytes, fp ) != (size_t)bytes )
+  {
+    fprintf( stderr, "Failed to read the serialized records\n" );
+    return false;
+  }
+
+  fclose( fp );
+  BenchAllocator allocator;
+  allocator.Init( 64 * 1024 );
+  start = clock();
+  size_t offset = 0;
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    allocator.Reset();
+    size_t size = DDLParser::Deserialize( serializer, &m2, data + offset, bytes - offset, &allocator );
+
+    if ( size == 0 )
+    {
+      fprintf( stderr, "Failed to deserialize mariner\n" );
+      return false;
+    }
+
+    offset += size;
+  }
+
+  Report( "reflection Deserialize", Elapsed( start ), bytes );
+
+  bool ok = m2.health == m1.health && m2.weapon == m1.weapon && !strcmp( m2.name, m1.name );
+  ok = ok && m2.deaths.m_Count == 4 && !memcmp( m2.deaths.m_Elements, deaths, sizeof( deaths ) );
+  ok = ok && m2.completed.m_Count == 2 && !strcmp( ( (NativeCompleted*)m2.completed.m_Elements )[ 1 ].key, "E1M2" );
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Data does not match\n" );
+    return false;
+  }
+
+  free( data );
+  allocator.Destroy();
+  program.Destroy();
+  return true;
+}
+
+// Migrates native records to the same definition, which copies them, and to
+// one where the health is an i64, which converts each record but shares the
+// arrays.
+static bool BenchMigration( DDLParser::Definition* ddl, const char* source, size_t source_size, DDLParser::LinearAllocator* scratch )
+{
+  char* changed = (char*)malloc( source_size );
+  memcpy( changed, source, source_size );
+  char* health = strstr( changed, "u32        health" );
+
+  if ( !health )
+  {
+    fprintf( stderr, "Couldn't find the health field\n" );
+    return false;
+  }
+
+  memcpy( health, "i64", 3 );
+  char error[ 256 ];
+  BenchAllocator definition, program, allocator;
+  definition.Init( 1024 * 1024 );
+  program.Init( 64 * 1024 );
+  allocator.Init( 64 * 1024 );
+  DDLParser::Definition* new_ddl = DDLParser::Compile( &definition, scratch, changed, source_size, error, sizeof( error ), false, 32, DDLParser::kCompileDefaultImages );
+  DDLParser::MigrationProgram* identical = DDLParser::CompileMigration( &program, scratch, ddl, ddl, "Mariner", error, sizeof( error ) );
+  DDLParser::MigrationProgram* converted = new_ddl ? DDLParser::CompileMigration( &program, scratch, ddl, new_ddl, "Mariner", error, sizeof( error ) ) : 0;
+
+  if ( !identical || !converted )
+  {
+    fprintf( stderr, "%s\n", error );
+    return false;
+  }
+
+  DDLParser::Struct* structure = ddl->FindAggregate( "Mariner" )->ToStruct();
+  size_t old_size = DDLParser::GetNativeLayout( ddl, structure ).m_Size;
+  size_t new_size = DDLParser::GetNativeLayout( new_ddl, new_ddl->FindAggregate( "Mariner" )->ToStruct() ).m_Size;
+  NativeMariner* old_records = (NativeMariner*)malloc( NUM_RECORDS * old_size );
+  char* new_records = (char*)malloc( NUM_RECORDS * ( new_size > old_size ? new_size : old_size ) );
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    structure->GetDefaultImage()->Instantiate( old_records + i );
+    old_records[ i ].health = i;
+  }
+
+  clock_t start = clock();
+  bool ok = DDLParser::Migrate( identical, old_records, new_records, NUM_RECORDS, &allocator );
+  Report( "Migrate identical", Elapsed( start ), (long)( NUM_RECORDS * old_size ) );
+  ok = ok && ( (NativeMariner*)new_records )[ NUM_RECORDS - 1 ].health == NUM_RECORDS - 1;
+
+  start = clock();
+  ok = ok && DDLParser::Migrate( converted, old_records, new_records, NUM_RECORDS, &allocator );
+  Report( "Migrate converted", Elapsed( start ), (long)( NUM_RECORDS * old_size ) );
+  ok = ok && *(int64_t*)( new_records + ( NUM_RECORDS - 1 ) * new_size ) == NUM_RECORDS - 1;
+
+  free( old_records );
+  free( new_records );
+  free( changed );
+  definition.Destroy();
+  program.Destroy();
+  allocator.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Migrated data does not match\n" );
+  }
+
+  return ok;
+}
+
+int main( int argc, char* argv[] )
+{
+  const char* ddl_name = argc > 1 ? argv[ 1 ] : "test/test.ddl";
+  size_t source_size;
+  char* source = ReadFile( ddl_name, &source_size );
+
+  if ( !source )
+  {
+    fprintf( stderr, "Couldn't read %s\n", ddl_name );
+    return -1;
+  }
+
+  BenchAllocator definition, scratch;
+  definition.Init( 1024 * 1024 );
+  scratch.Init( 1024 * 1024 );
+  char error[ 256 ];
+  DDLParser::Definition* ddl = DDLParser::Compile( &definition, &scratch, source, source_size, error, sizeof( error ), false, 32, DDLParser::kCompileDefaultImages );
+
+  if ( !ddl )
+  {
+    fprintf( stderr, "%s\n", error );
+    return -1;
+  }
+
+  // The large select is generated by util/createbench.lua.
+  const char* select_name = argc > 2 ? argv[ 2 ] : "test/bench_select.ddl";
+  size_t select_size;
+  char* select_source = ReadFile( select_name, &select_size );
+  BenchAllocator select_definition;
+  select_definition.Init( 1024 * 1024 );
+  DDLParser::Definition* select_ddl = select_source ? DDLParser::Compile( &select_definition, &scratch, select_source, select_size, error, sizeof( error ), false, 32, 0 ) : 0;
+
+  if ( !select_ddl )
+  {
+    fprintf( stderr, "Couldn't compile %s\n", select_name );
+    return -1;
+  }
+
+  Mariner m1;
+  m1.Init();
+  Position p;
+
+  for ( int i = 0; i < 4; i++ )
+  {
+    p.SetX( i * 3 + 1 );
+    p.SetY( i * 3 + 2 );
+    p.SetAngle( i * 3 + 3 );
+    m1.AppendDeaths( p );
+  }
+
+  m1.InsertCompleted( "E1M1", 100 );
+  m1.InsertCompleted( "E1M2", 50 );
+
+  bool ok = BenchGenerated( m1 ) && BenchBuffered( m1 ) && BenchIndexed( m1 ) && BenchStream( m1 ) && BenchView( m1 ) && BenchCompare( m1 ) && BenchDelta( m1 ) && BenchMove( m1 ) && BenchPool( m1 ) && BenchSoA() && BenchLargeArray();
+  ok = ok && BenchHashmap( 1000 ) && BenchHashmap( 1000000 );
+  ok = ok && BenchSelect< Weapon >( ddl, "Weapon" ) && BenchSelect< Large >( select_ddl, "Large" ) && BenchReflection( ddl, &scratch ) && BenchMigration( ddl, source, source_size, &scratch );
+  m1.Destroy();
+  definition.Destroy();
+  select_definition.Destroy();
+  scratch.Destroy();
+  free( source );
+  free( select_source );
+  return ok ? 0 : -1;
+}
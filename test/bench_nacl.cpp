@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "test_nacl_ddl.h"
+
+// Number of records written and read by each benchmark.
+#define NUM_RECORDS 200000
+
+static double Elapsed( clock_t start )
+{
+  return (double)( clock() - start ) / CLOCKS_PER_SEC;
+}
+
+static void Report( const char* name, double seconds, long bytes, long records = NUM_RECORDS )
+{
+  printf( "%-28s %8.3f s %10.0f records/s %8.1f MB/s\n", name, seconds, records / seconds, bytes / seconds / ( 1024.0 * 1024.0 ) );
+}
+
+// A minimal generic JSON document, standing in for the DOM libraries the
+// generated ReadJson replaces: the text is parsed into a tree, and the values
+// are then looked up and copied by hand.
+struct DomValue
+{
+  enum Type { kNull, kBool, kNumber, kString, kArray, kObject };
+
+  Type                              type;
+  bool                              boolean;
+  double                            number;
+  std::string                       string;
+  std::vector< DomValue >           elements;
+  std::map< std::string, DomValue > members;
+};
+
+static void DomSkipWhitespace( const char*& json )
+{
+  while ( *json == ' ' || *json == '\n' || *json == '\r' || *json == '\t' )
+  {
+    json++;
+  }
+}
+
+static bool DomParseString( const char*& json, std::string& value )
+{
+  value.clear();
+
+  for ( json++; *json != '"'; json++ )
+  {
+    if ( *json == 0 )
+    {
+      return false;
+    }
+    else if ( *json == '\\' )
+    {
+      json++;
+      value += *json == 'n' ? '\n' : *json == 't' ? '\t' : *json;
+    }
+    else
+    {
+      value += *json;
+    }
+  }
+
+  json++;
+  return true;
+}
+
+static bool DomParse( const char*& json, DomValue& value )
+{
+  DomSkipWhitespace( json );
+
+  if ( *json == '{' )
+  {
+    value.type = DomValue::kObject;
+    json++;
+    DomSkipWhitespace( json );
+
+    while ( *json != '}' )
+    {
+      std::string key;
+
+      if ( *json != '"' || !DomParseString( json, key ) )
+      {
+        return false;
+      }
+
+      DomSkipWhitespace( json );
+
+      if ( *json++ != ':' || !DomParse( json, value.members[ key ] ) )
+      {
+        return false;
+      }
+
+      DomSkipWhitespace( json );
+
+      if ( *json == ',' )
+      {
+        json++;
+        DomSkipWhitespace( json );
+      }
+    }
+
+    json++;
+    return true;
+  }
+  else if ( *json == '[' )
+  {
+    value.type = DomValue::kArray;
+    json++;
+    DomSkipWhitespace( json );
+
+    while ( *json != ']' )
+    {
+      value.elements.push_back( DomValue() );
+
+      if ( !DomParse( json, value.elements.back() ) )
+      {
+        return false;
+      }
+
+      DomSkipWhitespace( json );
+
+      if ( *json == ',' )
+      {
+        json++;
+      }
+    }
+
+    json++;
+    return true;
+  }
+  else if ( *json == '"' )
+  {
+    value.type = DomValue::kString;
+    return DomParseString( json, value.string );
+  }
+  else if ( strncmp( json, "true", 4 ) == 0 || strncmp( json, "false", 5 ) == 0 )
+  {
+    value.type = DomValue::kBool;
+    value.boolean = *json == 't';
+    json += value.boolean ? 4 : 5;
+    return true;
+  }
+  else if ( strncmp( json, "null", 4 ) == 0 )
+  {
+    value.type = DomValue::kNull;
+    json += 4;
+    return true;
+  }
+
+  char* end;
+  value.type = DomValue::kNumber;
+  value.number = strtod( json, &end );
+
+  if ( end == json )
+  {
+    return false;
+  }
+
+  json = end;
+  return true;
+}
+
+static const DomValue* DomFind( const DomValue& object, const char* key, DomValue::Type type )
+{
+  std::map< std::string, DomValue >::const_iterator it = object.members.find( key );
+  return it != object.members.end() && it->second.type == type ? &it->second : 0;
+}
+
+static bool DomToMariner( const DomValue& dom, Mariner& mariner )
+{
+  static const struct { const char* name; uint32_t value; } weapons[] =
+  {
+    { "kFist", Weapon::kFist }, { "kChainsaw", Weapon::kChainsaw }, { "kPistol", Weapon::kPistol },
+    { "kShotgun", Weapon::kShotgun }, { "kChaingun", Weapon::kChaingun }, { "kRocketLauncher", Weapon::kRocketLauncher },
+    { "kPlasmaGun", Weapon::kPlasmaGun }, { "kBFG9000", Weapon::kBFG9000 }
+  };
+
+  const DomValue* value;
+
+  if ( ( value = DomFind( dom, "Health", DomValue::kNumber ) ) != 0 )
+  {
+    mariner.SetHealth( (uint32_t)value->number );
+  }
+
+  if ( ( value = DomFind( dom, "Weapon", DomValue::kString ) ) != 0 )
+  {
+    size_t i = 0;
+
+    while ( i < sizeof( weapons ) / sizeof( weapons[ 0 ] ) && value->string != weapons[ i ].name )
+    {
+      i++;
+    }
+
+    if ( i == sizeof( weapons ) / sizeof( weapons[ 0 ] ) )
+    {
+      return false;
+    }
+
+    mariner.GetWeapon().Set( weapons[ i ].value );
+  }
+
+  if ( ( value = DomFind( dom, "Powerup", DomValue::kNumber ) ) != 0 && !mariner.GetPowerup().Set( (uint32_t)value->number ) )
+  {
+    return false;
+  }
+
+  if ( ( value = DomFind( dom, "Name", DomValue::kString ) ) != 0 )
+  {
+    mariner.SetName( value->string );
+  }
+
+  if ( ( value = DomFind( dom, "Position", DomValue::kObject ) ) != 0 )
+  {
+    const DomValue* number;
+
+    if ( ( number = DomFind( *value, "X", DomValue::kNumber ) ) != 0 )
+    {
+      mariner.GetPosition().SetX( (float)number->number );
+    }
+
+    if ( ( number = DomFind( *value, "Y", DomValue::kNumber ) ) != 0 )
+    {
+      mariner.GetPosition().SetY( (float)number->number );
+    }
+
+    if ( ( number = DomFind( *value, "Angle", DomValue::kNumber ) ) != 0 )
+    {
+      mariner.GetPosition().SetAngle( (float)number->number );
+    }
+  }
+
+  return true;
+}
+
+static bool BenchWriteJson( Mariner& m1 )
+{
+  JsonBuffer output;
+  long bytes = 0;
+
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    output.Clear();
+
+    if ( !m1.WriteJson( output ) )
+    {
+      fprintf( stderr, "Failed to write mariner\n" );
+      return false;
+    }
+
+    bytes += output.GetSize();
+  }
+
+  Report( "JSON write", Elapsed( start ), bytes );
+  return true;
+}
+
+static bool BenchReadJson( Mariner& m1 )
+{
+  JsonBuffer output;
+
+  // The DOM parser expects a nul terminated string.
+  if ( !m1.WriteJson( output ) )
+  {
+    fprintf( stderr, "Failed to write mariner\n" );
+    return false;
+  }
+
+  output.Append( '\0' );
+  const char* json = output.GetData();
+  size_t size = output.GetSize() - 1;
+
+  Mariner m2;
+  m2.Init();
+
+  clock_t start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS; i++ )
+  {
+    if ( !m2.ReadJson( json, size ) )
+    {
+      fprintf( stderr, "Failed to read mariner\n" );
+      m2.Destroy();
+      return false;
+    }
+  }
+
+  Report( "JSON read (generated)", Elapsed( start ), (long)size * NUM_RECORDS );
+  bool ok = m2.GetName() == m1.GetName() && m2.GetPosition().GetX() == m1.GetPosition().GetX();
+
+  start = clock();
+
+  for ( int i = 0; i < NUM_RECORDS && ok; i++ )
+  {
+    const char* cursor = json;
+    DomValue dom;
+    ok = DomParse( cursor, dom ) && DomToMariner( dom, m2 );
+  }
+
+  if ( !ok )
+  {
+    fprintf( stderr, "JSON data does not match\n" );
+    m2.Destroy();
+    return false;
+  }
+
+  Report( "JSON read (DOM)", Elapsed( start ), (long)size * NUM_RECORDS );
+  m2.Destroy();
+  return true;
+}
+
+int main()
+{
+  Mariner m1;
+  m1.Init();
+  m1.SetName( "Doom \"Guy\"" );
+  m1.GetPosition().SetX( 100.25f );
+  m1.GetPosition().SetY( -120.5f );
+  m1.GetPosition().SetAngle( 0.1f );
+
+  bool ok = BenchWriteJson( m1 ) && BenchReadJson( m1 );
+  m1.Destroy();
+  return ok ? 0 : -1;
+}
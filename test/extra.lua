@@ -2,6 +2,52 @@ function capitalize( str )
   return str:sub( 1, 1 ):upper() .. str:sub( 2, -1 )
 end
 
+local stringType = 'std::string'
+
+-- Sets the C++ type of string, file and json fields.
+function setCppStringType( ctype )
+  stringType = ctype
+end
+
+local mapTypes =
+{
+  map = 'std::map',
+  unordered = 'std::unordered_map',
+  flat = 'DDLFlatMap'
+}
+
+local mapType = mapTypes.map
+local vectorType = 'std::vector'
+
+-- Sets the C++ container of hashmap fields, one of 'map', 'unordered' or
+-- 'flat'. With arena set, the std::pmr version of the container is used.
+function setCppMapType( map, arena )
+  if not mapTypes[ map ] then
+    error( 'Unknown map type ' .. map )
+  end
+
+  if arena and map == 'flat' then
+    error( 'Map type flat can\'t be used with an arena' )
+  end
+
+  mapType = arena and ( mapTypes[ map ]:gsub( '^std::', 'std::pmr::' ) ) or mapTypes[ map ]
+end
+
+-- Sets the C++ container of dynamic array fields.
+function setCppVectorType( ctype )
+  vectorType = ctype
+end
+
+-- Returns the C++ type of a dynamic array field.
+function getCppVectorType( field )
+  return vectorType .. '< ' .. getCppType( field ) .. ' >'
+end
+
+-- Returns the C++ type of a hashmap field.
+function getCppMapType( field )
+  return mapType .. '< ' .. getCppType( field:getKeyType() ) .. ', ' .. getCppType( field ) .. ' >'
+end
+
 function getCppType( field )
   local ftype
   
@@ -29,11 +75,11 @@ function getCppType( field )
     int64 = 'int64_t',
     float32 = 'float',
     float64 = 'double',
-    string = 'std::string',
+    string = stringType,
     boolean = 'bool',
-    file = 'std::string',
+    file = stringType,
     tuid = 'uint64_t',
-    json = 'std::string'
+    json = stringType
   })[ ftype ]
 end
 
@@ -63,6 +109,18 @@ function getCppTypeSize( field )
   })[ ftype ] and ( 'sizeof( ' .. getCppType( field ) .. ' )' )
 end
 
+-- Returns true if a structure or field has a generic tag with the given
+-- name, like tag( Pooled ).
+function hasGenericTag( node, name )
+  for tag in node:tags() do
+    if tag:getType() == 'generic' and tag:getGenericName() == name then
+      return true
+    end
+  end
+
+  return false
+end
+
 function getFlagValue( flag )
   local value = flag:getValue()
 
@@ -1,13 +1,999 @@
+#ifdef TEST_SLIM
+// Included before anything else, to check that the header of a single
+// aggregate compiles on its own.
+#include "test_slim_ddl_Mariner.h"
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+
+#include <limits>
 
 #ifndef __WIN__
 #include <unistd.h>
 #endif
 
+#include <DDLParser.h>
+
+#if defined( TEST_STRING_VIEW )
+#include "test_string_view_ddl.h"
+#include "test_string_view_view_ddl.h"
+#elif defined( TEST_VARINT )
+#include "test_varint_ddl.h"
+#include "test_varint_view_ddl.h"
+#elif defined( TEST_DIRTY )
+#include "test_dirty_ddl.h"
+#include "test_dirty_view_ddl.h"
+#elif defined( TEST_UNORDERED )
+#include "test_unordered_ddl.h"
+#include "test_unordered_view_ddl.h"
+#elif defined( TEST_FLAT )
+#include "test_flat_ddl.h"
+#include "test_flat_view_ddl.h"
+#elif defined( TEST_ARENA )
+#include "test_arena_ddl.h"
+#include "test_arena_view_ddl.h"
+#elif defined( TEST_SLIM )
+#include "test_slim_ddl.h"
+#include "test_slim_view_ddl.h"
+#else
 #include "test_ddl.h"
+#include "test_view_ddl.h"
+#endif
+#include "test_soa_ddl.h"
+#include "bench_select_ddl.h"
+
+#ifdef TEST_ARENA
+// Counts the allocations from the heap, to check that records built in an
+// arena never fall back to it.
+static size_t s_HeapAllocations = 0;
+
+void* operator new( size_t size )
+{
+  s_HeapAllocations++;
+  void* memory = malloc( size != 0 ? size : 1 );
+
+  if ( !memory )
+  {
+    throw std::bad_alloc();
+  }
+
+  return memory;
+}
+
+void operator delete( void* memory ) noexcept
+{
+  free( memory );
+}
+
+void operator delete( void* memory, size_t ) noexcept
+{
+  free( memory );
+}
+#endif
+
+// Linear allocator over a single block, which remembers the largest size
+// asked for so tests can check that corrupt input isn't trusted.
+class TestAllocator: public DDLParser::LinearAllocator
+{
+private:
+  char*  m_Base;
+  size_t m_MaxSizeInBytes;
+  size_t m_CurrentOffset;
+
+public:
+  size_t m_Largest;
+
+  bool Init( size_t max_size_in_bytes )
+  {
+    m_Base = (char*)malloc( max_size_in_bytes );
+    m_MaxSizeInBytes = max_size_in_bytes;
+    m_CurrentOffset = 0;
+    m_Largest = 0;
+    return m_Base != 0;
+  }
+
+  void Destroy()
+  {
+    free( m_Base );
+  }
+
+  void* Allocate( size_t size_in_bytes, size_t alignment_in_bytes = 1 )
+  {
+    size_t offset = ( m_CurrentOffset + alignment_in_bytes - 1 ) & ~( alignment_in_bytes - 1 );
+    m_Largest = size_in_bytes > m_Largest ? size_in_bytes : m_Largest;
+
+    if ( offset + size_in_bytes > m_MaxSizeInBytes )
+    {
+      return 0;
+    }
+
+    m_CurrentOffset = offset + size_in_bytes;
+    return m_Base + offset;
+  }
+
+  void* GetBase() const
+  {
+    return m_Base;
+  }
+
+  size_t GetCurrentOffset() const
+  {
+    return m_CurrentOffset;
+  }
+
+  void Reset()
+  {
+    m_CurrentOffset = 0;
+  }
+};
+
+// Mariner in the native layout used by the reflection serializer.
+struct NativePosition
+{
+  float x, y, angle;
+};
+
+struct NativeCompleted
+{
+  const char* key;
+  uint32_t    value;
+};
+
+struct NativeMariner
+{
+  uint32_t                health;
+  uint32_t                weapon;
+  uint32_t                powerup;
+  int32_t                 ammunition[ 8 ];
+  const char*             name;
+  NativePosition          position;
+  DDLParser::NativeArray  deaths;
+  DDLParser::NativeArray  completed;
+};
+
+// The versions of a structure converted by the migration test.
+struct OldPosition
+{
+  float x, y;
+};
+
+struct OldMariner
+{
+  uint8_t                 health;
+  int32_t                 armor;
+  uint32_t                weapon;
+  uint32_t                powerup;
+  int32_t                 ammunition[ 4 ];
+  uint16_t                keys[ 3 ];
+  const char*             name;
+  DDLParser::NativeArray  deaths;
+  DDLParser::NativeArray  scores;
+};
+
+struct NewPosition
+{
+  float y, x, angle;
+};
+
+struct NewMariner
+{
+  uint32_t                health;
+  int8_t                  armor;
+  uint32_t                weapon;
+  uint32_t                powerup;
+  int32_t                 ammunition[ 2 ];
+  uint16_t                keys[ 6 ];
+  const char*             name;
+  DDLParser::NativeArray  deaths;
+  DDLParser::NativeArray  scores;
+  const char*             title;
+};
+
+struct Stats
+{
+  uint32_t kills;
+  float    accuracy;
+};
+
+static const char* s_OldSource =
+  "select Weapon { fist; chainsaw; pistol, default; shotgun; }\n"
+  "bitfield Powerup { none, empty; radiationSuit; berserk; }\n"
+  "struct Position { f32 x, value( 0 ); f32 y, value( 0 ); }\n"
+  "struct Stats { u32 kills; f32 accuracy; }\n"
+  "struct Mariner\n"
+  "{\n"
+  "  u8 health; i32 armor; Weapon weapon; Powerup powerup; i32[ 4 ] ammunition; u16[ 3 ] keys;\n"
+  "  string name; Position[] deaths; u32[] scores;\n"
+  "}\n";
+
+// Drops the chainsaw, renames the radiation suit and moves the berserk flag,
+// swaps the position's fields and adds one, narrows the armor, widens the
+// health, shrinks and grows the fixed arrays and adds a title.
+static const char* s_NewSource =
+  "select Weapon { fist; pistol, default; shotgun; plasmaGun; }\n"
+  "bitfield Powerup { none, empty; berserk; radSuit; lightVisor; }\n"
+  "struct Position { f32 y, value( 0 ); f32 x, value( 0 ); f32 angle, value( 7 ); }\n"
+  "struct Stats { u32 kills; f32 accuracy; }\n"
+  "struct Mariner\n"
+  "{\n"
+  "  u32 health; i8 armor; Weapon weapon; Powerup powerup; i32[ 2 ] ammunition; u16[ 6 ] keys, value( { 1, 2, 3, 4, 5, 6 } );\n"
+  "  string name; Position[] deaths; u32[] scores; string title, value( \"Rookie\" );\n"
+  "}\n";
+
+static char* ReadFile( const char* name, size_t* size )
+{
+  FILE* fp = fopen( name, "rb" );
+
+  if ( !fp )
+  {
+    return 0;
+  }
+
+  fseek( fp, 0, SEEK_END );
+  *size = ftell( fp );
+  fseek( fp, 0, SEEK_SET );
+  char* buffer = (char*)malloc( *size );
+
+  if ( buffer && fread( buffer, 1, *size, fp ) != *size )
+  {
+    free( buffer );
+    buffer = 0;
+  }
+
+  fclose( fp );
+  return buffer;
+}
+
+static DDLParser::Definition* CompileSource( TestAllocator* definition, TestAllocator* scratch, const char* source, size_t size, uint32_t options = DDLParser::kCompileDefaultImages )
+{
+  char error[ 256 ];
+  DDLParser::Definition* ddl = DDLParser::Compile( definition, scratch, source, size, error, sizeof( error ), false, 32, options );
+
+  if ( !ddl )
+  {
+    fprintf( stderr, "%s\n", error );
+  }
+
+  return ddl;
+}
+
+// Checks the native layout and the default image against the native
+// structure, and round-trips an instance through the serializer, making sure
+// truncated records and corrupt counts are rejected without allocating.
+static bool TestSerializer( DDLParser::Definition* ddl )
+{
+  DDLParser::Struct* structure = ddl->FindAggregate( "Mariner" )->ToStruct();
+  uint32_t offsets[ 8 ];
+  DDLParser::NativeLayout layout = DDLParser::GetNativeLayout( ddl, structure, offsets );
+
+  bool ok = layout.m_Size == sizeof( NativeMariner ) && layout.m_NumFields == 8;
+  ok = ok && offsets[ 3 ] == offsetof( NativeMariner, ammunition ) && offsets[ 4 ] == offsetof( NativeMariner, name );
+  ok = ok && offsets[ 5 ] == offsetof( NativeMariner, position ) && offsets[ 7 ] == offsetof( NativeMariner, completed );
+
+  NativeMariner m1, m2;
+  ok = ok && structure->GetDefaultImage() != 0;
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Native layout does not match\n" );
+    return false;
+  }
+
+  structure->GetDefaultImage()->Instantiate( &m1 );
+  ok = m1.health == 100 && m1.weapon == Weapon::kPistol && m1.powerup == Powerup::kBerserk;
+  ok = ok && m1.ammunition[ 2 ] == 20 && m1.ammunition[ 7 ] == -1 && !strcmp( m1.name, "Mariner" );
+  ok = ok && m1.position.x == 100 && m1.position.y == 120 && m1.deaths.m_Count == 0 && m1.completed.m_Count == 0;
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Default image does not match\n" );
+    return false;
+  }
+
+  char error[ 256 ];
+  TestAllocator program, scratch, allocator;
+  program.Init( 64 * 1024 );
+  scratch.Init( 64 * 1024 );
+  allocator.Init( 64 * 1024 );
+  DDLParser::SerializerProgram* serializer = DDLParser::CompileSerializer( &program, &scratch, ddl, structure, error, sizeof( error ) );
+
+  NativePosition deaths[ 2 ] = { { 1, 2, 3 }, { 4, 5, 6 } };
+  NativeCompleted completed[ 2 ] = { { "E1M1", 100 }, { "E1M2", 50 } };
+  m1.deaths.m_Elements = deaths;
+  m1.deaths.m_Count = 2;
+  m1.completed.m_Elements = completed;
+  m1.completed.m_Count = 2;
+
+  char buffer[ 1024 ];
+  size_t size = serializer ? DDLParser::Serialize( serializer, &m1, buffer, sizeof( buffer ) ) : 0;
+  ok = size != 0 && size <= sizeof( buffer ) && DDLParser::Deserialize( serializer, &m2, buffer, size, &allocator ) == size;
+  ok = ok && m2.health == 100 && m2.weapon == Weapon::kPistol && !strcmp( m2.name, "Mariner" ) && m2.position.y == 120;
+  ok = ok && m2.deaths.m_Count == 2 && !memcmp( m2.deaths.m_Elements, deaths, sizeof( deaths ) );
+  ok = ok && m2.completed.m_Count == 2 && !strcmp( ( (NativeCompleted*)m2.completed.m_Elements )[ 1 ].key, "E1M2" );
+  ok = ok && ( (NativeCompleted*)m2.completed.m_Elements )[ 1 ].value == 50;
+  ok = ok && DDLParser::Deserialize( serializer, &m2, buffer, size - 1, &allocator ) == 0;
+
+  // The name's length follows the three numbers and the ammunition, the
+  // completed levels' count comes last but for the two levels.
+  size_t name = 3 * sizeof( uint32_t ) + sizeof( m1.ammunition );
+  size_t count = size - 2 * ( 2 * sizeof( uint32_t ) + 4 ) - sizeof( uint32_t );
+  uint32_t huge = 0x7fffffff;
+  allocator.m_Largest = 0;
+
+  if ( ok && count > name && count + sizeof( huge ) <= size )
+  {
+    memcpy( buffer + count, &huge, sizeof( huge ) );
+    ok = DDLParser::Deserialize( serializer, &m2, buffer, size, &allocator ) == 0;
+    memcpy( buffer + name, &huge, sizeof( huge ) );
+    ok = ok && DDLParser::Deserialize( serializer, &m2, buffer, size, &allocator ) == 0 && allocator.m_Largest < 1024;
+  }
+  else
+  {
+    ok = false;
+  }
+
+  program.Destroy();
+  scratch.Destroy();
+  allocator.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Serialized data does not match\n" );
+  }
+
+  return ok;
+}
+
+// Converts records between two versions of a structure, checking each kind
+// of conversion: numbers saturate, fixed arrays are truncated or keep the
+// new defaults, removed select items become the default, flags are remapped
+// by name, arrays of changed structures are rebuilt and the others shared,
+// and structures that didn't change are copied as they are.
+static bool TestMigration()
+{
+  char error[ 256 ];
+  TestAllocator old_definition, new_definition, scratch, program, allocator;
+  old_definition.Init( 64 * 1024 );
+  new_definition.Init( 64 * 1024 );
+  scratch.Init( 256 * 1024 );
+  program.Init( 64 * 1024 );
+  allocator.Init( 64 * 1024 );
+
+  DDLParser::Definition* old_ddl = CompileSource( &old_definition, &scratch, s_OldSource, strlen( s_OldSource ) );
+  DDLParser::Definition* new_ddl = CompileSource( &new_definition, &scratch, s_NewSource, strlen( s_NewSource ) );
+  DDLParser::MigrationProgram* mariners = 0;
+  DDLParser::MigrationProgram* stats = 0;
+
+  if ( old_ddl && new_ddl )
+  {
+    mariners = DDLParser::CompileMigration( &program, &scratch, old_ddl, new_ddl, "Mariner", error, sizeof( error ) );
+    stats = DDLParser::CompileMigration( &program, &scratch, old_ddl, new_ddl, "Stats", error, sizeof( error ) );
+  }
+
+  bool ok = mariners != 0 && stats != 0;
+  ok = ok && DDLParser::GetNativeLayout( old_ddl, old_ddl->FindAggregate( "Mariner" )->ToStruct() ).m_Size == sizeof( OldMariner );
+  ok = ok && DDLParser::GetNativeLayout( new_ddl, new_ddl->FindAggregate( "Mariner" )->ToStruct() ).m_Size == sizeof( NewMariner );
+
+  if ( ok )
+  {
+    OldPosition deaths[ 2 ] = { { 1, 2 }, { 3, 4 } };
+    uint32_t scores[ 3 ] = { 10, 20, 30 };
+    OldMariner old_records[ 2 ];
+    NewMariner new_records[ 2 ];
+    memset( old_records, 0, sizeof( old_records ) );
+
+    for ( int i = 0; i < 2; i++ )
+    {
+      OldMariner& m = old_records[ i ];
+      m.health = 200;
+      m.armor = i == 0 ? -1000 : 1000;
+      m.weapon = DDLParser::StringCrc32( i == 0 ? "chainsaw" : "shotgun" );
+      m.powerup = i == 0 ? 3 : 1;
+      m.ammunition[ 0 ] = 1; m.ammunition[ 1 ] = 2; m.ammunition[ 2 ] = 3; m.ammunition[ 3 ] = 4;
+      m.keys[ 0 ] = 7; m.keys[ 1 ] = 8; m.keys[ 2 ] = 9;
+      m.name = "Doom Guy";
+      m.deaths.m_Elements = deaths;
+      m.deaths.m_Count = 2;
+      m.scores.m_Elements = scores;
+      m.scores.m_Count = 3;
+    }
+
+    ok = DDLParser::Migrate( mariners, old_records, new_records, 2, &allocator );
+
+    const NewMariner& m0 = new_records[ 0 ];
+    const NewMariner& m1 = new_records[ 1 ];
+    ok = ok && m0.health == 200 && m0.armor == -128 && m1.armor == 127;
+    ok = ok && m0.weapon == DDLParser::StringCrc32( "pistol" ) && m1.weapon == DDLParser::StringCrc32( "shotgun" );
+    ok = ok && m0.powerup == 1 && m1.powerup == 0;
+    ok = ok && m0.ammunition[ 0 ] == 1 && m0.ammunition[ 1 ] == 2;
+    ok = ok && m0.keys[ 0 ] == 7 && m0.keys[ 2 ] == 9 && m0.keys[ 3 ] == 4 && m0.keys[ 5 ] == 6;
+    ok = ok && m0.name == old_records[ 0 ].name && !strcmp( m0.title, "Rookie" );
+    ok = ok && m0.scores.m_Elements == scores && m0.scores.m_Count == 3;
+
+    const NewPosition* positions = (const NewPosition*)m0.deaths.m_Elements;
+    ok = ok && m0.deaths.m_Count == 2 && positions != 0 && (const void*)positions != (const void*)deaths;
+    ok = ok && positions[ 0 ].x == 1 && positions[ 0 ].y == 2 && positions[ 1 ].x == 3 && positions[ 1 ].angle == 7;
+    ok = ok && m1.deaths.m_Elements != m0.deaths.m_Elements;
+
+    Stats old_stats[ 3 ] = { { 1, 0.5f }, { 2, 0.25f }, { 3, 0.125f } };
+    Stats new_stats[ 3 ];
+    ok = ok && DDLParser::Migrate( stats, old_stats, new_stats, 3, &allocator ) && !memcmp( old_stats, new_stats, sizeof( old_stats ) );
+  }
+
+  old_definition.Destroy();
+  new_definition.Destroy();
+  scratch.Destroy();
+  program.Destroy();
+  allocator.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Migrated data does not match\n" );
+  }
+
+  return ok;
+}
+
+// Changes a select and checks that the structure using it changes too, and
+// that DiffDefinitions reports the added, removed and changed aggregates.
+static bool TestDiff()
+{
+  const char* old_source =
+    "select Weapon { fist; pistol, default; }\n"
+    "struct Position { f32 x; }\n"
+    "struct Mariner { Weapon weapon; Position position; }\n"
+    "struct Removed { u8 a; }\n";
+
+  const char* new_source =
+    "select Weapon { fist; pistol, default; shotgun; }\n"
+    "struct Position { f32 x; }\n"
+    "struct Mariner { Weapon weapon; Position position; }\n"
+    "struct Added { u8 b; }\n";
+
+  TestAllocator old_definition, new_definition, plain_definition, scratch;
+  old_definition.Init( 64 * 1024 );
+  new_definition.Init( 64 * 1024 );
+  plain_definition.Init( 64 * 1024 );
+  scratch.Init( 256 * 1024 );
+
+  DDLParser::Definition* old_ddl = CompileSource( &old_definition, &scratch, old_source, strlen( old_source ), DDLParser::kCompileContentHashes );
+  DDLParser::Definition* new_ddl = CompileSource( &new_definition, &scratch, new_source, strlen( new_source ), DDLParser::kCompileContentHashes );
+  DDLParser::Definition* plain_ddl = CompileSource( &plain_definition, &scratch, old_source, strlen( old_source ), 0 );
+  bool ok = old_ddl && new_ddl && plain_ddl;
+
+  if ( ok )
+  {
+    DDLParser::Aggregate* old_mariner = old_ddl->FindAggregate( "Mariner" );
+    DDLParser::Aggregate* new_mariner = new_ddl->FindAggregate( "Mariner" );
+    ok = old_mariner->GetContentHash() != 0 && old_mariner->GetContentHash() != new_mariner->GetContentHash();
+    ok = ok && old_ddl->FindAggregate( "Position" )->GetContentHash() == new_ddl->FindAggregate( "Position" )->GetContentHash();
+    ok = ok && plain_ddl->FindAggregate( "Mariner" )->GetContentHash() == 0;
+
+    // The total is returned even when only some differences fit.
+    DDLParser::DefinitionDiff diffs[ 8 ], first[ 2 ];
+    int32_t count = DDLParser::DiffDefinitions( old_ddl, new_ddl, &scratch, diffs, 8 );
+    ok = ok && count == 4 && DDLParser::DiffDefinitions( old_ddl, new_ddl, &scratch, first, 2 ) == 4;
+    ok = ok && first[ 1 ].m_NameHash == diffs[ 1 ].m_NameHash;
+
+    for ( int32_t i = 0; i < count && ok; i++ )
+    {
+      const DDLParser::DefinitionDiff& diff = diffs[ i ];
+      ok = i == 0 || diffs[ i - 1 ].m_NameHash < diff.m_NameHash;
+
+      if ( diff.m_NameHash == DDLParser::StringCrc32( "Weapon" ) || diff.m_NameHash == DDLParser::StringCrc32( "Mariner" ) )
+      {
+        ok = ok && diff.m_Type == DDLParser::kDiffChanged && diff.m_Old != 0 && diff.m_New != 0;
+      }
+      else if ( diff.m_NameHash == DDLParser::StringCrc32( "Removed" ) )
+      {
+        ok = ok && diff.m_Type == DDLParser::kDiffRemoved && diff.m_Old != 0 && diff.m_New == 0;
+      }
+      else
+      {
+        ok = ok && diff.m_NameHash == DDLParser::StringCrc32( "Added" ) && diff.m_Type == DDLParser::kDiffAdded && diff.m_Old == 0 && diff.m_New != 0;
+      }
+    }
+
+    // Without content hashes every aggregate is changed.
+    ok = ok && DDLParser::DiffDefinitions( plain_ddl, plain_ddl, &scratch, diffs, 8 ) == 4;
+    ok = ok && DDLParser::DiffDefinitions( old_ddl, old_ddl, &scratch, diffs, 8 ) == 0;
+  }
+
+  old_definition.Destroy();
+  new_definition.Destroy();
+  plain_definition.Destroy();
+  scratch.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Definition differences do not match\n" );
+  }
+
+  return ok;
+}
+
+static bool IsEmpty( const char* str )
+{
+  return str == 0 || *str == 0;
+}
+
+static bool IsSame( const char* str1, const char* str2 )
+{
+  return IsEmpty( str1 ) ? IsEmpty( str2 ) : str2 != 0 && !strcmp( str1, str2 );
+}
+
+// Writes the definition to a container and loads the hot section, which must
+// have the same names, hashes and default images but no descriptions or
+// labels, then the cold section, after which the content hashes computed
+// from the relocated definition must match the stored ones. Corrupt
+// sections are rejected.
+static bool TestContainer( DDLParser::Definition* ddl )
+{
+  TestAllocator scratch;
+  scratch.Init( 1024 * 1024 );
+  uint32_t options = DDLParser::kCompileDefaultImages | DDLParser::kCompileContentHashes;
+  size_t size = DDLParser::WriteContainer( ddl, &scratch, options, 0x12345678, 0, 0 );
+  char* data = (char*)malloc( size );
+  scratch.Reset();
+
+  const DDLParser::ContainerHeader* header = 0;
+  bool ok = size != 0 && DDLParser::WriteContainer( ddl, &scratch, options, 0x12345678, data, size ) == size;
+  ok = ok && ( header = DDLParser::ReadContainerHeader( data, size ) ) != 0 && header->m_SourceHash == 0x12345678;
+  ok = ok && header->m_Options == options && header->FindSection( DDLParser::kSectionHot ) && header->FindSection( DDLParser::kSectionCold );
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Container header does not match\n" );
+    free( data );
+    scratch.Destroy();
+    return false;
+  }
+
+  const char* hot = data + header->FindSection( DDLParser::kSectionHot )->m_Offset;
+  const char* cold = data + header->FindSection( DDLParser::kSectionCold )->m_Offset;
+  void* memory = malloc( header->m_DefinitionSize );
+  DDLParser::Definition* loaded = DDLParser::LoadHotSection( header, hot, memory );
+  ok = loaded != 0 && loaded->GetNumAggregates() == ddl->GetNumAggregates();
+
+  for ( uint32_t i = 0; ok && i < ddl->GetNumAggregates(); i++ )
+  {
+    DDLParser::Aggregate* original = ddl->GetAggregate( i );
+    DDLParser::Aggregate* aggregate = loaded->GetAggregate( i );
+    ok = !strcmp( aggregate->GetName(), original->GetName() ) && aggregate->GetNameHash() == original->GetNameHash();
+    ok = ok && aggregate->GetContentHash() == original->GetContentHash() && aggregate->GetContentHash() != 0;
+    ok = ok && IsEmpty( aggregate->GetDescription() ) && IsEmpty( aggregate->GetAuthor() );
+
+    // A label defaulted to the name shares its string, which stays hot.
+    ok = ok && ( IsEmpty( aggregate->GetLabel() ) || aggregate->GetLabel() == aggregate->GetName() );
+
+    if ( ok && aggregate->GetType() == DDLParser::kStruct )
+    {
+      DDLParser::Struct* structure = aggregate->ToStruct();
+      const DDLParser::DefaultImage* image = structure->GetDefaultImage();
+      const DDLParser::DefaultImage* original_image = original->ToStruct()->GetDefaultImage();
+      ok = image != 0 && image->m_InstanceSize == original_image->m_InstanceSize;
+      ok = ok && !memcmp( image->GetImage(), original_image->GetImage(), image->m_InstanceSize );
+      ok = ok && structure->GetNumFields() == original->ToStruct()->GetNumFields();
+
+      for ( uint32_t j = 0; ok && j < structure->GetNumFields(); j++ )
+      {
+        ok = !strcmp( ( *structure )[ j ]->GetName(), ( *original->ToStruct() )[ j ]->GetName() );
+        ok = ok && IsEmpty( ( *structure )[ j ]->GetDescription() );
+      }
+    }
+  }
+
+  // The default image's strings point into the relocated definition.
+  NativeMariner mariner;
+  ok = ok && !DDLParser::CheckContentHashes( loaded );
+  loaded->FindAggregate( "Mariner" )->ToStruct()->GetDefaultImage()->Instantiate( &mariner );
+  ok = ok && !strcmp( mariner.name, "Mariner" ) && mariner.health == 100;
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Container hot section does not match\n" );
+  }
+
+  ok = ok && DDLParser::LoadColdSection( header, cold, loaded ) && DDLParser::CheckContentHashes( loaded );
+
+  for ( uint32_t i = 0; ok && i < ddl->GetNumAggregates(); i++ )
+  {
+    DDLParser::Aggregate* original = ddl->GetAggregate( i );
+    DDLParser::Aggregate* aggregate = loaded->GetAggregate( i );
+    ok = IsSame( aggregate->GetDescription(), original->GetDescription() ) && IsSame( aggregate->GetLabel(), original->GetLabel() );
+    ok = ok && IsSame( aggregate->GetAuthor(), original->GetAuthor() );
+  }
+
+  ok = ok && !strcmp( loaded->FindAggregate( "Mariner" )->GetDescription(), "The player character" );
+
+  // Flipping a byte in either section fails its CRC.
+  data[ hot - data + 16 ] ^= 1;
+  ok = ok && DDLParser::LoadHotSection( header, hot, memory ) == 0;
+  data[ hot - data + 16 ] ^= 1;
+  data[ cold - data ] ^= 1;
+  ok = ok && DDLParser::LoadHotSection( header, hot, memory ) != 0 && !DDLParser::LoadColdSection( header, cold, (DDLParser::Definition*)memory );
+  data[ 0 ] ^= 1;
+  ok = ok && DDLParser::ReadContainerHeader( data, size ) == 0;
+
+  free( memory );
+  free( data );
+  scratch.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Container data does not match\n" );
+  }
+
+  return ok;
+}
+
+// Floats are ordered with NaNs and signed zeros in their place, so that the
+// generated comparisons are a strict weak ordering whatever the values.
+static bool TestFloatOrder()
+{
+  const float nan = std::numeric_limits< float >::quiet_NaN(), inf = std::numeric_limits< float >::infinity();
+  const float values[ 8 ] = { -nan, -inf, -1.0f, -0.0f, 0.0f, 1.0f, inf, nan };
+
+  Position p[ 8 ];
+  bool ok = true;
+
+  for ( int i = 0; i < 8; i++ )
+  {
+    p[ i ].Init();
+    p[ i ].SetY( values[ i ] );
+  }
+
+  for ( int a = 0; a < 8; a++ )
+  {
+    for ( int b = 0; b < 8; b++ )
+    {
+      // Antisymmetric, consistent with == and in the order of values.
+      int ab = p[ a ].Compare( p[ b ] ), ba = p[ b ].Compare( p[ a ] );
+      ok = ok && ( ab < 0 ) == ( ba > 0 ) && ( ab == 0 ) == ( ba == 0 ) && !( p[ a ] < p[ b ] && p[ b ] < p[ a ] );
+      ok = ok && ( ab == 0 ) == ( p[ a ] == p[ b ] ) && ( ab < 0 ) == ( a < b ) && ( ab == 0 ) == ( a == b );
+
+      for ( int c = 0; c < 8; c++ )
+      {
+        ok = ok && ( !( p[ a ] < p[ b ] && p[ b ] < p[ c ] ) || p[ a ] < p[ c ] );
+      }
+    }
+  }
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Float order does not match\n" );
+  }
+
+  return ok;
+}
+
+// Inserts levels out of key order, which the flat map has to sort, and checks
+// lookups, removals, comparisons and a round-trip through a buffer with the
+// container selected by --map.
+static bool TestHashmap()
+{
+  static const char* levels[ 6 ] = { "E1M5", "E1M2", "E1M9", "E1M1", "E1M7", "E1M3" };
+
+  Mariner m1, m2, m3;
+  m1.Init();
+  m2.Init();
+  m3.Init();
+  bool ok = true;
+
+  for ( int i = 0; i < 6; i++ )
+  {
+    ok = ok && m1.InsertCompleted( levels[ i ], i * 10 );
+    ok = ok && m3.InsertCompleted( levels[ 5 - i ], ( 5 - i ) * 10 );
+  }
 
-int main()
+  ok = ok && !m1.InsertCompleted( "E1M9", 99 ) && m1.GetCompletedCount() == 6 && m1.GetCompleted( "E1M9" ) == 20;
+
+  for ( int i = 0; i < 6; i++ )
+  {
+    ok = ok && m1.ExistsCompleted( levels[ i ] ) && m1.GetCompleted( levels[ i ] ) == (uint32_t)i * 10;
+  }
+
+  // The insertion order doesn't matter.
+  ok = ok && m1 == m3 && m1.Compare( m3 ) == 0 && m1.Hash() == m3.Hash();
+  ok = ok && !m1.ExistsCompleted( "E1M4" ) && m1.RemoveCompleted( "E1M2" ) && !m1.RemoveCompleted( "E1M2" );
+  ok = ok && m1.GetCompletedCount() == 5 && m1 != m3 && m1.Hash() != m3.Hash();
+  m1.SetCompleted( "E1M1", 100 );
+
+  char buffer[ 1024 ];
+  size_t size = m1.Save( buffer, sizeof( buffer ) );
+  ok = ok && size != 0 && m2.Load( buffer, size ) && m2.GetCompletedCount() == 5 && m2 == m1;
+  ok = ok && m2.GetCompleted( "E1M1" ) == 100 && m2.GetCompleted( "E1M3" ) == 50 && !m2.ExistsCompleted( "E1M2" );
+
+  m1.Destroy();
+  m2.Destroy();
+  m3.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Hashmap data does not match\n" );
+  }
+
+  return ok;
+}
+
+#ifdef TEST_ARENA
+// Default memory resource that counts the allocations of containers which
+// didn't get the arena's allocator.
+class CountingResource: public std::pmr::memory_resource
+{
+public:
+  size_t m_Allocations;
+
+  CountingResource(): m_Allocations( 0 ) {}
+
+private:
+  void* do_allocate( size_t bytes, size_t alignment ) override
+  {
+    m_Allocations++;
+    return std::pmr::new_delete_resource()->allocate( bytes, alignment );
+  }
+
+  void do_deallocate( void* memory, size_t bytes, size_t alignment ) override
+  {
+    std::pmr::new_delete_resource()->deallocate( memory, bytes, alignment );
+  }
+
+  bool do_is_equal( const std::pmr::memory_resource& other ) const noexcept override
+  {
+    return this == &other;
+  }
+};
+
+// Builds records in a fixed buffer whose upstream is null_memory_resource, so
+// that running out of it throws, and checks that loading and copying them
+// allocates neither from the heap nor from the default resource.
+static bool TestArena( const Mariner& m1 )
+{
+  static char storage[ 64 * 1024 ];
+  char buffer[ 1024 ];
+  size_t size = m1.Save( buffer, sizeof( buffer ) );
+  bool ok = size != 0;
+
+  std::pmr::monotonic_buffer_resource arena( storage, sizeof( storage ), std::pmr::null_memory_resource() );
+  Mariner* m2 = 0;
+  Mariner* m3 = 0;
+  CountingResource counting;
+  std::pmr::memory_resource* heap = std::pmr::set_default_resource( &counting );
+  size_t heap_allocations = s_HeapAllocations;
+
+  try
+  {
+    m2 = Mariner::Create( &arena );
+    m3 = Mariner::Create( &arena );
+    ok = ok && m2->Init() && m3->Init() && m2->Load( buffer, size );
+    *m3 = *m2;
+    Mariner m4( *m2, Mariner::allocator_type( &arena ) );
+    ok = ok && m4.GetDeathsCount() == m1.GetDeathsCount() && m4.GetName() == m2->GetName();
+    m4.Destroy();
+  }
+  catch ( const std::bad_alloc& )
+  {
+    ok = false;
+  }
+
+  std::pmr::set_default_resource( heap );
+  ok = ok && s_HeapAllocations == heap_allocations && counting.m_Allocations == 0 && *m2 == m1 && *m3 == m1;
+  ok = ok && m3->GetName().get_allocator().resource() == &arena && m3->GetCompletedMap().get_allocator().resource() == &arena;
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Arena data does not match\n" );
+  }
+
+  return ok;
+}
+#endif
+
+#ifdef TEST_VARINT
+// Loads a record with its health, the first field, replaced by the varint in
+// prefix.
+static bool LoadHealth( Mariner& m, const char* record, size_t size, const char* prefix, size_t prefix_size, size_t health_size )
+{
+  char buffer[ 1024 ];
+  memcpy( buffer, prefix, prefix_size );
+  memcpy( buffer + prefix_size, record + health_size, size - health_size );
+  return m.Load( buffer, prefix_size + size - health_size );
+}
+
+// Checks the sizes of varints and zigzag-encoded negative numbers, and makes
+// sure truncated records and varints that are too long or too large for
+// their field are rejected.
+static bool TestVarint()
+{
+  static const int32_t ammunition[ 8 ] = { 0, 1, -1, 63, -64, 64, 2147483647, -2147483647 - 1 };
+
+  Mariner m1, m2;
+  m1.Init();
+  m2.Init();
+  m1.SetHealth( 300 );
+
+  for ( size_t i = 0; i < 8; i++ )
+  {
+    m1.SetAmmunition( i, 0 );
+  }
+
+  char zeros[ 1024 ], record[ 1024 ];
+  size_t zeros_size = m1.Save( zeros, sizeof( zeros ) );
+
+  for ( size_t i = 0; i < 8; i++ )
+  {
+    m1.SetAmmunition( i, ammunition[ i ] );
+  }
+
+  // 300 takes two bytes. Zigzag keeps -1 and -64 in one byte, and 64 and
+  // both limits add one and four bytes each.
+  size_t size = m1.Save( record, sizeof( record ) );
+  bool ok = size == m1.GetSerializedSize() && size == zeros_size + 9;
+  ok = ok && (uint8_t)record[ 0 ] == 0xac && record[ 1 ] == 0x02;
+  ok = ok && m2.Load( record, size ) && m2.GetHealth() == 300;
+
+  for ( size_t i = 0; i < 8; i++ )
+  {
+    ok = ok && m2.GetAmmunition( i ) == ammunition[ i ];
+  }
+
+  for ( size_t i = 0; i < size; i++ )
+  {
+    ok = ok && !m2.Load( record, i );
+  }
+
+  static const char one[] = { 0x01 };
+  static const char overlong[] = { -0x80, -0x80, -0x80, -0x80, -0x80, -0x80, -0x80, -0x80, -0x80, -0x80, 0x01 };
+  static const char overflow[] = { -0x80, -0x80, -0x80, -0x80, 0x10 };
+
+  ok = ok && LoadHealth( m2, record, size, one, sizeof( one ), 2 ) && m2.GetHealth() == 1;
+  ok = ok && !LoadHealth( m2, record, size, overlong, sizeof( overlong ), 2 );
+  ok = ok && !LoadHealth( m2, record, size, overflow, sizeof( overflow ), 2 );
+
+  m1.Destroy();
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Varint data does not match\n" );
+  }
+
+  return ok;
+}
+#endif
+
+#ifdef TEST_DIRTY
+// Checks that setters, array and hashmap changes and non-const getters flag
+// the right fields, that applying a delta reproduces the changes, nested
+// structures included, and that corrupt deltas are rejected.
+static bool TestDirty()
+{
+  Mariner m1;
+  m1.Init();
+  m1.ClearDirty();
+
+  const Mariner& c = m1;
+  c.GetWeapon();
+  m1.GetPosition();
+  bool ok = !m1.IsDirty() && m1.GetDirtyMask() == 0;
+
+  m1.SetHealth( 50 );
+  ok = ok && m1.GetDirtyMask() == Mariner::kHealthField;
+  m1.GetWeapon().Set( Weapon::kShotgun );
+  m1.SetAmmunition( 1, 10 );
+  ok = ok && m1.GetDirtyMask() == ( Mariner::kHealthField | Mariner::kWeaponField | Mariner::kAmmunitionField );
+  m1.ClearDirty();
+  m1.SetName( "Doom Guy" );
+  m1.GetPowerup().Set( Powerup::kComputerMap );
+  ok = ok && m1.GetDirtyMask() == ( Mariner::kNameField | Mariner::kPowerupField );
+
+  Position p;
+  p.Init();
+  p.SetX( 7 );
+  m1.ClearDirty();
+  m1.AppendDeaths( p );
+  ok = ok && m1.GetDirtyMask() == Mariner::kDeathsField;
+  m1.ClearDirty();
+  m1.GetDeaths( 0 ).SetY( 8 );
+  ok = ok && m1.GetDirtyMask() == Mariner::kDeathsField;
+  m1.ClearDirty();
+  m1.RemoveDeaths( 0 );
+  ok = ok && m1.GetDirtyMask() == Mariner::kDeathsField;
+  m1.ClearDirty();
+  m1.InsertCompleted( "E1M1", 100 );
+  ok = ok && m1.GetDirtyMask() == Mariner::kCompletedField;
+  m1.ClearDirty();
+  m1.RemoveCompleted( "E1M1" );
+  ok = ok && m1.GetDirtyMask() == Mariner::kCompletedField;
+
+  // Nested structures track their own fields.
+  m1.ClearDirty();
+  m1.GetPosition().SetAngle( 90 );
+  ok = ok && m1.GetDirtyMask() == Mariner::kPositionField && m1.GetPosition().GetDirtyMask() == 4;
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Dirty fields do not match\n" );
+    m1.Destroy();
+    p.Destroy();
+    return false;
+  }
+
+  // A delta without changes is just the mask.
+  m1.ClearDirty();
+  Mariner m2 = m1, m3 = m1;
+  char buffer[ 1024 ];
+  size_t size = m1.SaveDelta( buffer, sizeof( buffer ) );
+  ok = size == 1 && m2.ApplyDelta( buffer, size ) && m2 == m1;
+
+  m1.SetHealth( 75 );
+  m1.SetName( "Mariner 2" );
+  m1.GetPosition().SetY( -5 );
+  m1.AppendDeaths( p );
+  m1.InsertCompleted( "E1M2", 50 );
+  size = m1.SaveDelta( buffer, sizeof( buffer ) );
+  ok = ok && size != 0 && m2 != m1 && !m2.ApplyDelta( buffer, size - 1 );
+
+  // Apply to a fresh copy, since a rejected delta may leave fields changed.
+  // Applied fields aren't flagged.
+  m2 = m3;
+  ok = ok && m2.ApplyDelta( buffer, size ) && m2 == m1 && !m2.IsDirty();
+  ok = ok && m2.GetHealth() == 75 && m2.GetName() == m1.GetName() && m2.GetPosition().GetY() == -5;
+  ok = ok && m2.GetPosition().GetAngle() == 90 && m2.GetDeathsCount() == 1 && m2.GetCompleted( "E1M2" ) == 50;
+
+  // Masks must not have bits past the structure's fields, Position has three.
+  static const char position[] = { 1 << 5, 1 << 1, 0, 0, 0, 0 };
+  static const char unknown[] = { 1 << 5, 1 << 3 };
+  ok = ok && m2.ApplyDelta( position, sizeof( position ) ) && m2.GetPosition().GetY() == 0;
+  ok = ok && !m2.ApplyDelta( unknown, sizeof( unknown ) ) && !p.ApplyDelta( unknown + 1, 1 );
+
+  m1.Destroy();
+  m2.Destroy();
+  m3.Destroy();
+  p.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Delta data does not match\n" );
+  }
+
+  return ok;
+}
+#endif
+
+// Checks that every item of the select goes from its name to its value and
+// back, and that a name with an extra character isn't found.
+template< typename T >
+static bool TestSelectNames( DDLParser::Definition* ddl, const char* name )
+{
+  DDLParser::Select* select = ddl->FindAggregate( name )->ToSelect();
+  bool ok = select->GetNumItems() != 0;
+
+  for ( uint32_t i = 0; ok && i < select->GetNumItems(); i++ )
+  {
+    const char* item = ( *select )[ i ]->GetName();
+    uint32_t value = ( *select )[ i ]->GetNameHash();
+    size_t length = strlen( item );
+    char longer[ 256 ];
+    sprintf( longer, "%s!", item );
+
+    ok = T::FromName( item, length ) == value && T::IsValid( value );
+    ok = ok && T::ToName( value ) != NULL && !strcmp( T::ToName( value ), item );
+    ok = ok && T::FromName( longer, length + 1 ) == 0;
+  }
+
+  if ( !ok )
+  {
+    fprintf( stderr, "%s names do not match\n", name );
+  }
+
+  return ok;
+}
+
+int main( int argc, char* argv[] )
 {
   Mariner m1, m2;
   
@@ -24,6 +1010,18 @@ int main()
   m1.AppendDeaths( p );
   m1.InsertCompleted( "E1M1", 100 );
   
+#ifdef DDLT_STRING_VIEW
+  // Strings are loaded as views into the input, which must outlive m2, so
+  // there's no Load( FILE* ).
+  static char input[ 1024 ];
+  size_t input_size = m1.Save( input, sizeof( input ) );
+
+  if ( input_size == 0 || !m2.Load( input, input_size ) )
+  {
+    fprintf( stderr, "Failed to load mariner\n" );
+    return -1;
+  }
+#else
   FILE* fp = fopen( "mariner.dat", "wb" );
   if ( !m1.Save( fp ) )
   {
@@ -43,6 +1041,7 @@ int main()
   fclose( fp );
 
   unlink( "mariner.dat" );
+#endif
   
   bool ok = true;
   
@@ -88,6 +1087,274 @@ int main()
     return -1;
   }
 
+  // The generated comparisons agree, and order by the first differing field.
+  ok = m1 == m2 && !( m1 != m2 ) && m1.Hash() == m2.Hash() && m1.Compare( m2 ) == 0;
+  m2.SetName( "Mariner 2" );
+  ok = ok && m1 != m2 && m1 < m2 && m2.Compare( m1 ) > 0 && m1.Hash() != m2.Hash();
+  m2.SetName( m1.GetName() );
+  m2.GetDeaths( 0 ).SetAngle( -3 );
+  ok = ok && m1 != m2 && m2 < m1 && m1.Hash() != m2.Hash();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Comparisons do not match\n" );
+    return -1;
+  }
+
+  // Convert between the names and the values of select items.
+  ok = Weapon::FromName( "rocketLauncher", 14 ) == Weapon::kRocketLauncher && Weapon::FromName( "rocket", 6 ) == 0;
+  ok = ok && Weapon::FromName( "BFG9000x", 7 ) == Weapon::kBFG9000 && Weapon::FromName( "", 0 ) == 0;
+  ok = ok && strcmp( Weapon::ToName( Weapon::kFist ), "fist" ) == 0 && Weapon::ToName( Weapon::kFist + 1 ) == NULL;
+  ok = ok && Weapon::IsValid( Weapon::kPistol ) && !Weapon::IsValid( 0 );
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Select names do not match\n" );
+    return -1;
+  }
+
+  // Fill arrays in bulk and in place, remove from them without keeping the
+  // order, and move whole structures.
+  Mariner m3;
+  m3.Init();
+  m3.ReserveDeaths( 4 );
+  Position positions[ 3 ];
+
+  for ( int i = 0; i < 3; i++ )
+  {
+    positions[ i ].Init();
+    positions[ i ].SetX( (float)i );
+  }
+
+  m3.AssignDeaths( positions, positions + 3 );
+  m3.SwapRemoveDeaths( 0 );
+  ok = m3.GetDeathsCapacity() >= 4 && m3.GetDeathsCount() == 2 && m3.GetDeaths( 0 ).GetX() == 2 && m3.GetDeaths( 1 ).GetX() == 1;
+
+#ifdef DDLT_CPP11
+  // The string type depends on the template options, i.e. --arena.
+  std::decay< decltype( m3.GetName() ) >::type name( "Doom Guy" );
+  m3.SetName( std::move( name ) );
+  m3.EmplaceDeaths().SetX( 5 );
+  Mariner m4( std::move( m3 ) );
+  ok = ok && m4.GetName() == "Doom Guy" && m4.GetDeathsCount() == 3 && m4.GetDeaths( 2 ).GetX() == 5;
+  ok = ok && m3.GetDeathsCount() == 0 && m3.GetName().length() == 0;
+  m4.Destroy();
+
+  // Growing moves the records, leaving destroyed ones behind for the
+  // destructor's checks.
+  std::vector< Mariner > records;
+
+  for ( int i = 0; i < 5; i++ )
+  {
+    records.push_back( m1 );
+  }
+
+  ok = ok && records[ 0 ] == m1 && records[ 4 ] == m1;
+
+  for ( size_t i = 0; i < records.size(); i++ )
+  {
+    records[ i ].Destroy();
+  }
+#endif
+
+  m3.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Array operations do not match\n" );
+    return -1;
+  }
+
+#ifdef DDLT_CPP11
+  // Pooled objects are reused with their arrays' storage, and come back
+  // initialized.
+  Mariner* pooled = Mariner::Acquire();
+  pooled->ReserveDeaths( 16 );
+  pooled->AppendDeaths( p );
+  pooled->SetHealth( 1 );
+  Mariner::Release( pooled );
+
+  Mariner* reused = Mariner::Acquire();
+  ok = reused == pooled && reused->GetDeathsCount() == 0 && reused->GetDeathsCapacity() >= 16 && reused->GetHealth() == 100;
+  Mariner::Release( reused );
+
+  DDLPoolStats stats = Mariner::GetPoolStats();
+  ok = ok && stats.hits == 1 && stats.misses == 1 && stats.releases == 2 && stats.size == 1 && stats.high_water == 1;
+  Mariner::TrimPool( 0 );
+  ok = ok && Mariner::GetPoolStats().size == 0;
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Pooled objects do not match\n" );
+    return -1;
+  }
+#endif
+
+  // Round-trip through a memory buffer, and make sure truncated data is rejected.
+  char buffer[ 1024 ];
+  size_t size = m1.Save( buffer, sizeof( buffer ) );
+
+  ok = size == m1.GetSerializedSize() && m1.Save( buffer, size - 1 ) == 0;
+  ok = ok && !m2.Load( buffer, size - 1 ) && m2.Load( buffer, size );
+  ok = ok && m1.GetName() == m2.GetName() && m2.GetDeathsCount() == 1 && m2.GetCompleted( "E1M1" ) == 100;
+
+#ifdef DDLT_STRING_VIEW
+  // The name points into the buffer instead of being copied.
+  ok = ok && m2.GetName().data() > buffer && m2.GetName().data() + m2.GetName().length() <= buffer + size;
+  ok = ok && m2.GetName().data() != m1.GetName().data();
+#endif
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Buffered data does not match\n" );
+    return -1;
+  }
+
+  // Load only some fields from an indexed record, and make sure records from
+  // another schema or truncated ones are rejected.
+  size = m1.SaveIndexed( buffer, sizeof( buffer ) );
+  Mariner partial;
+  partial.Init();
+  partial.SetHealth( 1 );
+  ok = size != 0 && partial.LoadFields( buffer, size, Mariner::kNameField | Mariner::kCompletedField );
+  ok = ok && partial.GetName() == m1.GetName() && partial.GetCompleted( "E1M1" ) == 100;
+  ok = ok && partial.GetHealth() == 1 && partial.GetDeathsCount() == 0;
+  ok = ok && !partial.LoadFields( buffer, size - 1, Mariner::kHealthField ) && partial.GetHealth() == 1;
+  buffer[ 0 ] ^= 1;
+  ok = ok && !partial.LoadFields( buffer, size, Mariner::kHealthField ) && partial.GetHealth() == 1;
+  partial.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Indexed data does not match\n" );
+    return -1;
+  }
+
+  // Read the fields back in place through a view.
+  DDLWriter writer;
+  ok = MarinerView::Save( m1, writer );
+
+  MarinerView view( writer.GetData() );
+  ok = ok && view.GetHealth() == m1.GetHealth() && view.GetWeapon() == m1.GetWeapon().Get();
+  ok = ok && view.GetAmmunition( 2 ) == m1.GetAmmunition( 2 ) && view.GetName() == DDLStringView( m1.GetName().data(), m1.GetName().length() );
+  ok = ok && view.GetPosition().GetX() == m1.GetPosition().GetX() && view.GetDeathsCount() == 1;
+  ok = ok && view.GetDeaths( 0 ).GetY() == m1.GetDeaths( 0 ).GetY();
+  ok = ok && view.FindCompleted( "E1M1" ) == 0 && view.GetCompletedValue( 0 ) == 100;
+  ok = ok && view.FindCompleted( "E1M2" ) == view.GetCompletedCount();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "View data does not match\n" );
+    return -1;
+  }
+
+  // Store particles in columns, and make sure they survive removals and a
+  // round-trip through a buffer.
+  Particle particle;
+  particle.Init();
+  ParticleSoA particles;
+
+  for ( int i = 0; i < 100 && ok; i++ )
+  {
+    particle.GetPosition().SetX( (float)i );
+    particle.SetAlive( i % 2 == 0 );
+    ok = particles.Append( particle );
+  }
+
+  ok = ok && particles.GetCount() == 100 && (size_t)particles.GetVxColumn() % DDLT_SOA_ALIGNMENT == 0;
+  particles.Remove( 0 );
+  particles.SwapRemove( 0 );
+  particles.Get( 0, particle );
+  ok = ok && particle.GetPosition().GetX() == 99 && !particle.GetAlive() && particles.GetPositionXColumn()[ 1 ] == 2;
+
+  writer.Reset();
+  ParticleSoA loaded;
+  ok = ok && particles.Save( writer );
+  DDLReader soa_reader( writer.GetData(), writer.GetSize() ), truncated( writer.GetData(), writer.GetSize() - 1 );
+  ok = ok && !loaded.Load( truncated ) && loaded.Load( soa_reader ) && loaded.GetCount() == 98;
+  ok = ok && loaded.GetPositionXColumn()[ 97 ] == 98 && loaded.GetAliveColumn()[ 3 ];
+  particle.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Column data does not match\n" );
+    return -1;
+  }
+
+  // Append a few records to a file, and iterate over them from the mapped file.
+  remove( "mariner.dat" );
+  MarinerAppender appender;
+  ok = appender.Open( "mariner.dat" ) && appender.Append( m1 ) && appender.Append( m1 ) && appender.Append( m1 ) && appender.Close();
+
+  MarinerStreamReader stream;
+  ok = ok && stream.Open( "mariner.dat" ) && stream.Skip() && stream.Next( m2 ) && stream.Next( m2 );
+  ok = ok && stream.IsAtEnd() && !stream.Next( m2 ) && m1.GetName() == m2.GetName() && m2.GetCompleted( "E1M1" ) == 100;
+  stream.Close();
+  unlink( "mariner.dat" );
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Streamed data does not match\n" );
+    return -1;
+  }
+
+  // Compile the definition to check the library against the generated code.
+  const char* ddl_name = argc > 1 ? argv[ 1 ] : "test/test.ddl";
+  size_t source_size;
+  char* source = ReadFile( ddl_name, &source_size );
+
+  if ( !source )
+  {
+    fprintf( stderr, "Couldn't read %s\n", ddl_name );
+    return -1;
+  }
+
+  TestAllocator definition, scratch;
+  definition.Init( 1024 * 1024 );
+  scratch.Init( 1024 * 1024 );
+  DDLParser::Definition* ddl = CompileSource( &definition, &scratch, source, source_size, DDLParser::kCompileDefaultImages | DDLParser::kCompileContentHashes );
+
+  if ( !ddl )
+  {
+    return -1;
+  }
+
+  // The large select is generated by util/createbench.lua.
+  const char* select_name = argc > 2 ? argv[ 2 ] : "test/bench_select.ddl";
+  size_t select_size;
+  char* select_source = ReadFile( select_name, &select_size );
+  TestAllocator select_definition;
+  select_definition.Init( 1024 * 1024 );
+  DDLParser::Definition* select_ddl = select_source ? CompileSource( &select_definition, &scratch, select_source, select_size ) : 0;
+
+  if ( !select_ddl )
+  {
+    fprintf( stderr, "Couldn't compile %s\n", select_name );
+    return -1;
+  }
+
+  ok = TestSerializer( ddl ) && TestMigration() && TestDiff() && TestContainer( ddl ) && TestHashmap() && TestFloatOrder();
+  ok = ok && TestSelectNames< Weapon >( ddl, "Weapon" ) && TestSelectNames< Large >( select_ddl, "Large" );
+#ifdef TEST_VARINT
+  ok = ok && TestVarint();
+#endif
+#ifdef TEST_DIRTY
+  ok = ok && TestDirty();
+#endif
+#ifdef TEST_ARENA
+  ok = ok && TestArena( m1 );
+#endif
+  definition.Destroy();
+  select_definition.Destroy();
+  scratch.Destroy();
+  free( source );
+  free( select_source );
+
+  if ( !ok )
+  {
+    return -1;
+  }
+
   fprintf( stderr, "Success!\n" );
   return 0;
 }
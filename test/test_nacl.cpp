@@ -8,22 +8,137 @@
 
 #include "test_nacl_ddl.h"
 
+// A fixed buffer too small for the record makes WriteJson fail without
+// writing past its end, and a large enough one holds the same text as a
+// growable buffer.
+static bool TestFixedBuffer( Mariner& m1, const JsonBuffer& output )
+{
+  char data[ 4096 ];
+  memset( data, '#', sizeof( data ) );
+
+  JsonBuffer small( data, 32 );
+  bool ok = !m1.WriteJson( small ) && !small.IsOk() && small.GetSize() <= 32 && data[ 32 ] == '#';
+
+  JsonBuffer large( data, sizeof( data ) );
+  ok = ok && m1.WriteJson( large ) && large.IsOk() && large.GetSize() == output.GetSize();
+  ok = ok && !memcmp( large.GetData(), output.GetData(), output.GetSize() );
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Fixed buffer does not match\n" );
+  }
+
+  return ok;
+}
+
+// Quotes, backslashes and control characters are escaped, and read back.
+static bool TestEscaping( Mariner& m1, Mariner& m2 )
+{
+  m1.SetName( "q\"b\\s\n\t\x01/" );
+
+  JsonBuffer output;
+  bool ok = m1.WriteJson( output );
+  std::string json( output.GetData(), output.GetSize() );
+  ok = ok && json.find( "\"Name\": \"q\\\"b\\\\s\\n\\t\\u0001/\"" ) != std::string::npos;
+  ok = ok && m2.ReadJson( output.GetData(), output.GetSize() ) && m2.GetName() == m1.GetName();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Escaped strings do not match\n" );
+  }
+
+  return ok;
+}
+
+// Integers are written exactly, including the extremes, and floats with
+// enough digits to read back the same bits, the fewest when to_chars is
+// available.
+static bool TestNumbers( Mariner& m1, Mariner& m2 )
+{
+  JsonBuffer output;
+
+  {
+    JsonWriteScope scope( output );
+    scope.WriteInt( INT64_MIN );
+    scope.WriteUInt( UINT64_MAX );
+    scope.WriteInt( 0 );
+    scope.WriteInt( -1 );
+    scope.WriteFloat( 0.1f );
+  }
+
+  std::string json( output.GetData(), output.GetSize() );
+#ifdef JSON_WRITE_TO_CHARS
+  bool ok = json == "-9223372036854775808,18446744073709551615,0,-1,0.1";
+#else
+  bool ok = json.compare( 0, json.rfind( ',' ) + 1, "-9223372036854775808,18446744073709551615,0,-1," ) == 0;
+#endif
+
+  static const float values[] = { 0.1f, 1.0f / 3.0f, 16777216.0f, 3.40282347e38f, 1.17549435e-38f, 1.40129846e-45f, -2.5e-10f };
+
+  for ( size_t i = 0; i < sizeof( values ) / sizeof( values[ 0 ] ) && ok; i++ )
+  {
+    m1.GetPosition().SetX( values[ i ] );
+    m1.GetPosition().SetY( -values[ i ] );
+    output.Clear();
+    ok = m1.WriteJson( output ) && m2.ReadJson( output.GetData(), output.GetSize() );
+
+    float x = m2.GetPosition().GetX(), y = m2.GetPosition().GetY(), minus = -values[ i ];
+    ok = ok && !memcmp( &x, &values[ i ], sizeof( x ) ) && !memcmp( &y, &minus, sizeof( y ) );
+  }
+
+  if ( !ok )
+  {
+    fprintf( stderr, "Numbers do not match\n" );
+  }
+
+  return ok;
+}
+
 int main()
 {
   Mariner m1;
 
   m1.Init();
 
-  char   output_buffer[ 4096 ];
-  char*  output_start  = output_buffer;
-  char*  output_cursor = output_start;
-  size_t output_size   = 0;
+  JsonBuffer output;
 
-  m1.WriteJson( output_cursor, output_size );
+  if ( !m1.WriteJson( output ) )
+  {
+    fprintf( stderr, "Failed to write mariner\n" );
+    m1.Destroy();
+    return -1;
+  }
 
-  fwrite( output_start, output_size, 1, stdout );
+  fwrite( output.GetData(), output.GetSize(), 1, stdout );
   
   printf("\n");
+
+  // Read the JSON back, then read a document with unknown keys and escapes.
+  Mariner m2;
+  m2.Init();
+  m2.SetHealth( 0 );
+
+  bool ok = m2.ReadJson( output.GetData(), output.GetSize() );
+  ok = ok && m2.GetHealth() == m1.GetHealth() && m2.GetWeapon().Get() == m1.GetWeapon().Get();
+  ok = ok && m2.GetName() == m1.GetName() && m2.GetPosition().GetY() == m1.GetPosition().GetY();
+
+  const char* json = "{ \"Unknown\": [ { \"a\": [] }, \"}\" ], \"Name\": \"D\\u00fcke\\n\", \"Weapon\": \"kBFG9000\", \"Position\": { \"Angle\": -0.5 } }";
+  ok = ok && m2.ReadJson( json, strlen( json ) ) && m2.GetName() == "D\xc3\xbcke\n";
+  ok = ok && m2.GetWeapon().Get() == Weapon::kBFG9000 && m2.GetPosition().GetAngle() == -0.5f;
+
+  const char* bad = "{ \"Weapon\": \"kSword\" }";
+  ok = ok && !m2.ReadJson( bad, strlen( bad ) );
+  ok = ok && TestFixedBuffer( m1, output ) && TestEscaping( m1, m2 ) && TestNumbers( m1, m2 );
+
+  m2.Destroy();
+
+  if ( !ok )
+  {
+    fprintf( stderr, "JSON data does not match\n" );
+    m1.Destroy();
+    return -1;
+  }
+
   printf("Complete.\n");
   
   m1.Destroy();
@@ -0,0 +1,85 @@
+if #arg == 2 and arg[ 1 ] == 'select' and tonumber( arg[ 2 ] ) then
+  io.write( 'select Large\n{\n' )
+
+  for i = 1, tonumber( arg[ 2 ] ) do
+    io.write( '  item', i, i == 1 and ', default;\n' or ';\n' )
+  end
+
+  io.write( '}\n' )
+  os.exit()
+end
+
+if #arg ~= 1 or not tonumber( arg[ 1 ] ) then
+  io.write[[
+Creates a DDL file with many structures, to time building the generated code,
+or with a large select, to time looking its items up by name.
+
+Usage: lua createbench.lua <count>
+       lua createbench.lua select <items>
+
+Where <count> is the number of structures, each with a different mix of
+numbers, strings, arrays, hashmaps, selects, bitfields and other structures,
+and <items> is the number of items of the select.
+]]
+  os.exit()
+end
+
+local count = tonumber( arg[ 1 ] )
+
+io.write[[
+select Kind
+{
+  none, default;
+  small;
+  medium;
+  large;
+}
+
+bitfield Flags
+{
+  none, empty;
+  visible;
+  active;
+  dirty;
+}
+
+struct Vector
+{
+  f32 x, value( 0 );
+  f32 y, value( 0 );
+  f32 z, value( 0 );
+}
+]]
+
+-- Each structure gets some of these fields depending on its index, and
+-- holds an array of the one before.
+local fields = {
+  'u32 id, value( %d );',
+  'string name, value( "Item %d" );',
+  'Kind kind;',
+  'Flags flags;',
+  'Vector position;',
+  'f32[ 4 ] weights;',
+  'u16[] indices;',
+  'Vector[] points;',
+  'u32{ string } counters;',
+  'string[] tags;',
+  'i64 stamp, value( -%d );',
+  'bool enabled, value( true );'
+}
+
+for i = 1, count do
+  io.write( '\nstruct Struct', i, '\n{\n' )
+
+  for j, field in ipairs( fields ) do
+    if ( i + j ) % 3 ~= 0 then
+      io.write( '  ', field:format( i ), '\n' )
+    end
+  end
+
+  if i > 1 then
+    io.write( '  Struct', i - 1, '[] previous;\n' )
+  end
+
+  io.write( '}\n' )
+end
@@ -200,7 +200,7 @@ struct Mariner, author( "Andre de Leiradella" ), description( "The player charac
 
 \header(1, 'DDLParser::Compile')
 
-\code[[DDLParser::Definition* DDLParser::Compile( DDLParser::LinearAllocator* definition, DDLParser::LinearAllocator* scratch, const void* source, size_t source_size, char* error, size_t error_size, bool two_us_reserved, int bitfield_limit )]]
+\code[[DDLParser::Definition* DDLParser::Compile( DDLParser::LinearAllocator* definition, DDLParser::LinearAllocator* scratch, const void* source, size_t source_size, char* error, size_t error_size, bool two_us_reserved, int bitfield_limit, uint32_t options = 0 )]]
 
 \p[[The DDLParser::Compile function compiles a DDL source file into a DDLParser::Definition ready to be used to generate code.]]
 
@@ -215,12 +215,108 @@ struct Mariner, author( "Andre de Leiradella" ), description( "The player charac
 [[\code'error_size': The size of the \code'error' buffer.]],
 [[\code'two_us_reserved': If true, identifiers starting with two underlines are reserved and disallowed in the source code.]],
 [[\code'bitfield_limit': The maximum number of flags allowed in a bitfield. If this value is zero, there is no limit on the number of flags per bitfield.]],
+[[\code'options': A combination of DDLParser::CompileOptions flags. \code'DDLParser::kCompileDefaultImages' adds a DDLParser::DefaultImage tag to every structure, and \code'DDLParser::kCompileContentHashes' adds a DDLParser::ContentHash tag to every aggregate. Both make the compiled definition larger, so they're off by default.]],
 }
 
 \header(2, 'Return value')
 
 \p[[If the parse succeeds it returns the definition assembled in \code'definition' casted to a DDLParser::Definition pointer. If there was an error, DDLParser::Compile returns NULL and \code'error' is filled with the error message.]]
 
+\header(1, 'DDLParser::GetNativeLayout')
+
+\p[[\code'DDLParser::NativeLayout DDLParser::GetNativeLayout( DDLParser::Definition* ddl, DDLParser::Struct* structure, uint32_t* offsets = 0 )']]
+
+\p[[Returns the size, alignment, and number of fields (including inherited ones) of the native, C-like layout of a structure. Parent fields come first, and each field is aligned to its natural alignment. Strings, files, and JSON fields are \code'const char*', selects and bitfields are \code'uint32_t', and dynamic arrays and hashmaps are a DDLParser::NativeArray. If \code'offsets' is not NULL, the offset of each field is written to it.]]
+
+\p[[\code'DDLParser::NativeLayout DDLParser::GetNativeLayout( DDLParser::Definition* ddl, const DDLParser::StructValueInfo* info )']]
+
+\p[[Returns the layout of one element of a field. Hashmap elements are a key followed by a value.]]
+
+\header(1, 'DDLParser::CompileSerializer')
+
+\p[[\code'DDLParser::SerializerProgram* DDLParser::CompileSerializer( DDLParser::LinearAllocator* program, DDLParser::LinearAllocator* scratch, DDLParser::Definition* ddl, DDLParser::Struct* structure, char* error, size_t error_size )']]
+
+\p[[Compiles a program to serialize instances of a structure in its native layout (see DDLParser::GetNativeLayout) into \code'program'. The program is a flat list of ops built once per structure, so the definition isn't visited again for each instance. Adjacent numeric fields are copied at once, and arrays of elements without strings or arrays are copied in bulk. Returns NULL and fills \code'error' if the structure has fields of unknown types.]]
+
+\p[[\code'size_t DDLParser::Serialize( const DDLParser::SerializerProgram* program, const void* instance, void* buffer, size_t buffer_size )']]
+
+\p[[Writes the instance to \code'buffer' and returns the number of bytes needed. If the result is greater than \code'buffer_size', the buffer was too small and must be enlarged. Numbers are written in the host byte order without padding, strings are prefixed by their length, and dynamic arrays and hashmaps by their number of elements.]]
+
+\p[[\code'size_t DDLParser::Deserialize( const DDLParser::SerializerProgram* program, void* instance, const void* buffer, size_t buffer_size, DDLParser::LinearAllocator* allocator )']]
+
+\p[[Reads an instance from \code'buffer' and returns the number of bytes read. Strings, dynamic arrays and hashmaps are allocated from \code'allocator'. Returns 0 if the buffer is truncated or if the allocator is out of memory.]]
+
+\p[[\code'make bench' runs a benchmark comparing the serializer with the \code'Save' and \code'Load' methods generated by the \code'cpp' template. The generated methods work on a \code'FILE*', on a memory span, or on the bounds-checked \code'DDLWriter' and \code'DDLReader' cursors; the \code'FILE*' versions compute the serialized size first and read or write each object with a single call. The \code'XxxAppender' and \code'XxxStreamReader' classes generated by the \code'hpp' template write records to a file in large batches, and iterate over them from the memory-mapped file; the benchmark times appending, loading and skipping all records sequentially. The benchmark also saves and loads a structure with a one million elements array, and times inserting, looking up, saving and loading hashmaps with one thousand and one million entries. The \code'--map' option of the \code'hpp' and \code'cpp' templates selects the container generated for hashmaps: \code'std::map' (\code'map', the default), \code'std::unordered_map' (\code'unordered') or a sorted vector (\code'flat'). The \code'view' template generates a read-only \code'View' class for each structure, which reads fields in place from a buffer written by its \code'Save' method without decoding or allocating; the benchmark compares reading two fields of each record with \code'Load' and with a view. The \code'cpp' template also generates \code'Hash', \code'operator==' and \code'Compare' methods, which handle runs of numbers, booleans, selects and bitfields laid out without padding with a single call; floats and doubles are equal when their bits are, and \code'Compare' orders them by the IEEE 754 totalOrder, with -0 before 0 and NaNs after the infinities, so that records with NaNs can still be sorted and used as keys. The benchmark times hashing and comparing records. Selects get static \code'FromName', \code'ToName' and \code'IsValid' methods, which find items in constant time in a minimal perfect hash of their values computed by \code'ddlt'; the benchmark compares \code'FromName' with \code'DDLParser::Select::FindItem' on the 8 items of the test's \code'Weapon' select, and on a select with 1000 items generated with \code'util/createbench.lua select 1000', where \code'FindItem' is much slower. When compiled as C++11, the structures, selects and bitfields generated by the \code'hpp' template can be moved, which leaves the source destroyed as by \code'Destroy', and their accessors take strings and structures by rvalue reference and construct array elements in place with \code'EmplaceXxx'; the benchmark compares filling a vector of records by copying and by moving them. The \code'soa' template generates an \code'XxxSoA' container for each structure made only of numbers, booleans and nested structures, which stores each field in its own column aligned to \code'DDLT_SOA_ALIGNMENT' bytes, 64 by default; the benchmark compares moving particles by their speeds in an array of structures and in the columns. It also times the \code'WriteJson' and \code'ReadJson' methods generated by the \code'nacl_hpp' and \code'nacl_cpp' templates, and compares \code'ReadJson', which dispatches on the CRC-32 of each key without building a document, with parsing the same JSON into a generic tree and copying the values by hand.]]
+
+\p[[The \code'cpp' and \code'nacl_cpp' templates accept \code'--shards N' to spread the generated code across N files, named like the output file with \code'_1' to \code'_N' added, so that they can be compiled in parallel. Aggregates go to the shard with the least code so far, largest first. The helpers shared by all aggregates are written once to a header named like the output file with \code'_shared.h' added, which every shard includes. \code'make bench_build' generates a DDL file with 200 structures with \code'util/createbench.lua', and times compiling the generated code as a single file and as 8 shards built in parallel.]]
+
+\p[[\code'make' also builds and runs the test with code generated with other template options: \code'test/test_string_view' uses \code'--string-view', where strings are loaded as views into the input buffer and there's no \code'Load( FILE* )', along with \code'--map unordered' so that hashmaps are keyed by the views, \code'test/test_varint' uses \code'--wire varint', and also checks the encoded sizes of zigzag-encoded negative numbers and that truncated and overlong varints are rejected, and \code'test/test_dirty' uses \code'--dirty', and also checks the fields flagged by setters and non-const getters, and that \code'ApplyDelta' reproduces the changes saved by \code'SaveDelta' and rejects masks with unknown bits, \code'test/test_unordered' and \code'test/test_flat' use \code'--map unordered' and \code'--map flat', \code'test/test_arena' uses \code'--arena --map unordered', is compiled as C++17, and also checks that loading and copying records built with \code'Create' in a \code'std::pmr::monotonic_buffer_resource' allocates neither from the heap nor from the default memory resource, and \code'test/test_slim' uses \code'--slim', includes the header of \code'Mariner' before anything else to check that it compiles on its own, and links the generated accessors. \code'make bench' also runs \code'test/bench_varint', whose record size and speeds can be compared with the default fixed-size encoding, \code'test/bench_dirty', which also times saving and applying a delta of two changed fields per record, and \code'test/bench_unordered' and \code'test/bench_flat', whose hashmap timings can be compared with the default \code'std::map'.]]
+
+\p[[The \code'hpp' template accepts \code'--slim' to write a header for each aggregate instead, named like the output file with \code'_' and the aggregate's name added. Each one only includes the standard headers its fields need and the headers of the aggregates it holds, so that files using a few aggregates don't compile the whole definition. The output file includes all of them, a header with \code'_fwd.h' added declares every aggregate, and a header with \code'_support.h' added holds the buffers and streams. Scalar accessors stay inline, but the ones that insert into and remove from arrays and hashmaps are defined in a file with \code'_accessors.cpp' added, which must be compiled along with the code generated by the \code'cpp' template.]]
+
+\p[[Structures tagged with \code'tag( Pooled )' get static \code'Acquire' and \code'Release' methods in the code generated by the \code'hpp' and \code'cpp' templates when compiled as C++11. They take objects from and return them to a free list local to the calling thread. Released objects are destroyed, which keeps the storage of their strings and arrays, and are initialized again when acquired, so creating and freeing short-lived objects stops allocating once the pool holds as many objects as are used at once. \code'GetPoolStats' returns the number of hits, misses and releases of the calling thread's pool, its size and its high-water mark, and \code'TrimPool' frees pooled objects.]]
+
+\p[[Structures with up to 64 fields also get \code'SaveIndexed' and \code'LoadFields'. Indexed records start with the structure's schema CRC, a hash of its fields that is also available as \code'kSchemaCrc', and a table with the offset of each field, so \code'LoadFields' decodes only the fields in its mask, built from constants like \code'Mariner::kNameField', and skips the others without reading them. Records written with another version of the structure are rejected.]]
+
+\header(1, 'DDLParser::CompileMigration')
+
+\p[[\code'DDLParser::MigrationProgram* DDLParser::CompileMigration( DDLParser::LinearAllocator* program, DDLParser::LinearAllocator* scratch, DDLParser::Definition* old_ddl, DDLParser::Definition* new_ddl, const char* name, char* error, size_t error_size )']]
+
+\p[[Compiles a program to convert instances of the structure \code'name' in its native layout from \code'old_ddl' to \code'new_ddl'. \code'new_ddl' must be compiled with \code'DDLParser::kCompileDefaultImages'. Fields are matched by name:]]
+
+\ul{
+  [[Numbers are converted to the new type, saturating when the new type is narrower.]],
+  [[Fixed arrays keep as many elements as fit in the new size, the other elements get their default values.]],
+  [[Select values of removed items become the default item of the new select.]],
+  [[Bitfield flags are moved to the bits of the flags with the same names, flags that were removed are cleared.]],
+  [[New fields, and fields that changed to an incompatible type or array type, get their default values.]],
+}
+
+\p[[If nothing changed in the structure, including nested structures, selects and bitfields, records are copied in bulk.]]
+
+\p[[\code'bool DDLParser::Migrate( const DDLParser::MigrationProgram* program, const void* old_records, void* new_records, size_t num_records, DDLParser::LinearAllocator* allocator )']]
+
+\p[[Converts \code'num_records' consecutive old instances to new ones. Strings and arrays that don't need conversion are shared with the old records, converted arrays are allocated from \code'allocator'. Returns \code'false' if the allocator runs out of memory.]]
+
+\header(1, 'DDLParser::DiffDefinitions')
+
+\p[[\code'int32_t DDLParser::DiffDefinitions( DDLParser::Definition* old_ddl, DDLParser::Definition* new_ddl, DDLParser::LinearAllocator* scratch, DDLParser::DefinitionDiff* diffs, uint32_t max_diffs )']]
+
+\p[[Finds the aggregates that were added, removed, or changed between two definitions, i.e. to decide what to reload or migrate when a DDL file is edited. Aggregates are matched by name hash and compared with DDLParser::Aggregate::GetContentHash, so only one hash is compared per aggregate. Both definitions must be compiled with \code'DDLParser::kCompileContentHashes', aggregates without content hashes are always reported as changed. \code'scratch' is used to sort the aggregates of both definitions.]]
+
+\p[[At most \code'max_diffs' differences are written to \code'diffs', sorted by name hash. Each one has its type, \code'DDLParser::kDiffAdded', \code'DDLParser::kDiffRemoved' or \code'DDLParser::kDiffChanged', the name hash, and the old and new aggregates, one of them being NULL for added and removed aggregates. Returns the total number of differences, which may be greater than \code'max_diffs', or -1 if \code'scratch' runs out of memory.]]
+
+\p[[\code'bool DDLParser::CheckContentHashes( DDLParser::Definition* ddl )']]
+
+\p[[Recomputes the content hash of every aggregate and compares it with the stored one, i.e. to check that a definition loaded from a container with both of its sections is intact. Returns \code'false' if an aggregate has no content hash or a different one.]]
+
+\header(1, 'DDLParser::WriteContainer')
+
+\p[[\code'size_t DDLParser::WriteContainer( DDLParser::Definition* ddl, DDLParser::LinearAllocator* scratch, uint32_t options, uint32_t source_hash, void* buffer, size_t buffer_size )']]
+
+\p[[Writes a definition to \code'buffer' in the container format used to cache and ship definitions, usually saved with the \code'.ddlb' extension. Returns the number of bytes needed. If the result is greater than \code'buffer_size' nothing is written, and 0 is returned if \code'scratch' runs out of memory. \code'options' are the DDLParser::CompileOptions used to compile the definition and \code'source_hash' is usually the DDLParser::Crc32 of the DDL source, both are only recorded in the header so readers can decide if a cached container is stale.]]
+
+\p[[The container starts with a DDLParser::ContainerHeader with the \code'DDLParser::kContainerMagic' and \code'DDLParser::kContainerVersion' values, followed by a table of DDLParser::ContainerSection entries with the type, offset, size, and CRC32 of each section. The definition is repacked into two sections:]]
+
+\ul{
+  [[\code'DDLParser::kSectionHot' has everything needed to generate code and to work with instances: names, hashes, types, array sizes, default values, default images, content hashes, and the other tags.]],
+  [[\code'DDLParser::kSectionCold' has the authors, descriptions, and labels, the \code'uirender', \code'units', \code'extensions', and \code'vaulthints' tags, and the default values of JSON fields. Strings also used by the hot section stay there.]],
+}
+
+\p[[The cold section is written right after the hot one, and the definition expects to find it there. A container read or mapped entirely in memory, aligned to 8 bytes, can be used in place with DDLParser::Definition::FromBinRep on the start of the hot section, without copying anything.]]
+
+\p[[\code'const DDLParser::ContainerHeader* DDLParser::ReadContainerHeader( const void* data, size_t size )']]
+
+\p[[Returns \code'data' cast to a DDLParser::ContainerHeader if it has the right magic number and version and the section table fits in \code'size' bytes, or NULL otherwise. \code'DDLParser::ContainerHeader::FindSection( uint32_t type )' returns a section given its type.]]
+
+\p[[\code'DDLParser::Definition* DDLParser::LoadHotSection( const DDLParser::ContainerHeader* header, const void* hot, void* memory )']]
+
+\p[[Checks the CRC of the hot section and copies it to \code'memory', which must be 8-byte aligned and have \code'm_DefinitionSize' bytes. The room for the cold section is cleared, so cold strings read as empty strings until the cold section is loaded. Returns NULL if the section is corrupt.]]
+
+\p[[\code'bool DDLParser::LoadColdSection( const DDLParser::ContainerHeader* header, const void* cold, DDLParser::Definition* ddl )']]
+
+\p[[Checks the CRC of the cold section and copies it after the hot section of a definition returned by DDLParser::LoadHotSection. Returns false if the section is corrupt.]]
+
 \header(1, 'DDLParser::StringCrc32')
 
 \p[[\code'uint32_t DDLParser::StringCrc32( const char* data )']]
@@ -277,6 +373,10 @@ struct Mariner, author( "Andre de Leiradella" ), description( "The player charac
 
 \p[[Returns the aggregate casted to DDLParser::Struct without checking for the actual aggregate type.]]
 
+\header(2, [[\code'uint32_t DDLParser::Aggregate::GetContentHash() const']], 'DDLParser::Aggregate::GetContentHash')
+
+\p[[Returns the hash stored by DDLParser::Compile in the DDLParser::ContentHash tag of the aggregate, or 0 if the definition wasn't compiled with \code'DDLParser::kCompileContentHashes'. Two aggregates with the same name and content hash are identical, including the selects, bitfields, and structures used by their fields.]]
+
 \header(1, 'DDLParser::Select')
 
 \p[[A select is like a C enum, but you can't define the value of the items. Their value is always the hash code of their identifiers. A select holds information about its items.]]
@@ -436,6 +536,10 @@ static void GenerateBitfield( DDLParser::Bitfield* bitfield )
 
 \p[[The schema crc reflects the type, count, name, and order of each field. If any of those change, then the crc changes. It does not reflect default values or any tags.]]
 
+\header(2, [[\code'DDLParser::DefaultImage* DDLParser::Struct::GetDefaultImage() const']], 'DDLParser::Struct::GetDefaultImage')
+
+\p[[Returns the default image of the structure, or NULL if the definition wasn't compiled with \code'DDLParser::kCompileDefaultImages'.]]
+
 \header(1, 'DDLParser::StructField')
 
 \p[[A field is an instance of a given type. A field has these common methods: \code'GetName', \code'GetAuthor', \code'GetDescription', \code'GetLabel', \code'GetDisplayLabel', \code'GetNameHash', \code'GetTags', and \code'GetTag'.]]
@@ -745,6 +849,29 @@ struct DDLParser::GenericTagValue
 
 \note[[DDLParser::Compile doesn't give the programmer the chance to install callbacks in the parser. For that, duplicate the source code of DDLParser::Compile and add the callbacks as needed.]]
 
+\header(1, 'DDLParser::DefaultImage')
+
+\p[[A tag of type DDLParser::kDefaultImage with an instance of the structure in its native layout (see DDLParser::GetNativeLayout), with all fields set to their default values. Instances can be initialized with one \code'memcpy' instead of visiting the fields. It has the following methods in addition to the methods from DDLParser::Tag:]]
+
+\ul{
+  [[\code'uint32_t DDLParser::DefaultImage::GetInstanceSize() const']],
+  [[\code'uint32_t DDLParser::DefaultImage::GetAlignment() const']],
+  [[\code'const void* DDLParser::DefaultImage::GetImage() const']],
+  [[\code'uint32_t DDLParser::DefaultImage::GetNumFixups() const']],
+  [[\code'const DDLParser::DefaultImageFixup* DDLParser::DefaultImage::GetFixup( uint32_t index ) const']],
+  [[\code'uint32_t DDLParser::DefaultImage::GetNumFields() const']],
+  [[\code'uint32_t DDLParser::DefaultImage::GetFieldOffset( uint32_t index ) const']],
+  [[\code'void DDLParser::DefaultImage::Instantiate( void* instance ) const']],
+}
+
+\p[[Pointers can't be stored in the image, so each string field has a fixup with its offset and default value. DDLParser::DefaultImage::Instantiate copies the image and writes the fixups, the strings point into the definition. Dynamic arrays and hashmaps are empty.]]
+
+\header(1, 'DDLParser::ContentHash')
+
+\p[[A tag of type DDLParser::kContentHash that DDLParser::Compile adds to every select, bitfield, and structure when given \code'DDLParser::kCompileContentHashes'. Its only method in addition to the methods from DDLParser::Tag is \code'uint32_t DDLParser::ContentHash::GetHash() const'.]]
+
+\p[[The hash covers the name, author, description, and label of the aggregate and of its items, flags, and fields, the types, array types, and default values of the fields, all tags except DDLParser::DefaultImage, and the content hashes of the parent structure and of the aggregates used by the fields.]]
+
 \header(1, 'DDLParser::Str')
 
 \p[[DDLParser::Str represent internal strings during the parsing. They point directly into the DDL source code being parsed so they cannot be changed. The methods that can be used to validate a generic tag are:]]
@@ -83,6 +83,8 @@ if platform == 'mingw' then
   config.DEPLIBS = '-llua -lastyle'
   config.DIRSEP  = '/'
   config.ALLDEPS = '$+'
+  config.SUBMAKE = '$(MAKE) -f $(firstword $(MAKEFILE_LIST)) -j ${SHARDS}'
+  config.CXX17   = '-std=c++17'
 elseif platform == 'linux' then
   config.EXEEXT  = ''
   config.OBJEXT  = '.o'
@@ -100,6 +102,8 @@ elseif platform == 'linux' then
   config.DEPLIBS = '-llua -lastyle'
   config.DIRSEP  = '/'
   config.ALLDEPS = '$+'
+  config.SUBMAKE = '$(MAKE) -f $(firstword $(MAKEFILE_LIST)) -j ${SHARDS}'
+  config.CXX17   = '-std=c++17'
 elseif platform == 'msvc-x64' then
   config.EXEEXT = '.exe'
   config.OBJEXT = '.obj'
@@ -117,6 +121,8 @@ elseif platform == 'msvc-x64' then
   config.DEPLIBS = 'deps\\lua-x64.lib deps\\AStyleLib-x64.lib'
   config.DIRSEP  = '\\'
   config.ALLDEPS = '$**'
+  config.SUBMAKE = '$(MAKE)'
+  config.CXX17   = '/std:c++17'
 elseif platform == 'msvc-x86' then
   config.EXEEXT = '.exe'
   config.OBJEXT = '.obj'
@@ -134,6 +140,8 @@ elseif platform == 'msvc-x86' then
   config.DEPLIBS = 'deps\\lua-x86.lib deps\\AStyleLib-x86.lib'
   config.DIRSEP  = '\\'
   config.ALLDEPS = '$**'
+  config.SUBMAKE = '$(MAKE)'
+  config.CXX17   = '/std:c++17'
 else
   error( 'Unknown platform ' .. platform )
 end
@@ -216,8 +224,96 @@ local function sub( key )
   return key
 end
 
+-- The build benchmark compiles the code generated for a large DDL file as a
+-- single file, and then split into shards compiled in parallel.
+local shards = 8
+local cpps, objs, rules = {}, {}, {}
+
+for i = 1, shards do
+  cpps[ i ]  = 'test~bench_build_ddl_' .. i .. '.cpp'
+  objs[ i ]  = 'test~bench_build_ddl_' .. i .. '${OBJEXT}'
+  rules[ i ] = objs[ i ] .. ': test~bench_build_ddl_1.cpp test~bench_build_ddl.h\n  ${CC:' .. cpps[ i ] .. '}\n\n'
+end
+
+config.SHARDCPPS  = table.concat( cpps, ' ' )
+config.SHARDOBJS  = table.concat( objs, ' ' )
+config.SHARDRULES = table.concat( rules )
+config.SHARDS     = tostring( shards )
+
+-- The test is also built with code generated with other template options,
+-- test.cpp includes the variant's headers when its define is set. The view
+-- template only gets the options it shares with hpp and cpp. Variants with
+-- bench set are also benchmarked by make bench, to compare them with the
+-- default options, and variants with cxx17 set are compiled as C++17.
+-- Variants with slim set run the hpp template with --slim, which also writes
+-- the listed aggregate headers and accessors that are compiled and linked.
+local variants = {
+  { name = 'string_view', options = '--string-view --map unordered', view = '--string-view --map unordered', define = 'TEST_STRING_VIEW' },
+  { name = 'varint', options = '--wire varint', view = '', define = 'TEST_VARINT', bench = true },
+  { name = 'dirty', options = '--dirty', view = '', define = 'TEST_DIRTY', bench = true },
+  { name = 'unordered', options = '--map unordered', view = '--map unordered', define = 'TEST_UNORDERED', bench = true },
+  { name = 'flat', options = '--map flat', view = '--map flat', define = 'TEST_FLAT', bench = true },
+  { name = 'arena', options = '--arena --map unordered', view = '--arena --map unordered', define = 'TEST_ARENA', cxx17 = true },
+  { name = 'slim', options = '', view = '', define = 'TEST_SLIM', slim = { 'Mariner', 'Particle', 'Position', 'Powerup', 'Weapon' } },
+}
+
+local exes, rules, files, benches, runs = {}, {}, {}, {}, {}
+
+for _, variant in ipairs( variants ) do
+  local test = 'test~test_' .. variant.name
+  local ddl = test .. '_ddl'
+  local flags = variant.cxx17 and config.CXX17 .. ' ' or ''
+  local objs = ddl .. '${OBJEXT}'
+  local hpp = variant.options
+  local gen = function( template, output, options )
+    return ( ( 'ddlt~ddlt -i test~test.ddl -t %s -o %s --search-path test %s' ):format( template, output, options ):gsub( '%s+$', '' ) )
+  end
+
+  if variant.slim then
+    local generated = { ddl .. '_fwd.h', ddl .. '_support.h', ddl .. '_accessors.cpp', ddl .. '_accessors${OBJEXT}' }
+
+    for _, aggregate in ipairs( variant.slim ) do
+      generated[ #generated + 1 ] = ddl .. '_' .. aggregate .. '.h'
+    end
+
+    objs = objs .. ' ' .. ddl .. '_accessors${OBJEXT}'
+    hpp = ( hpp ~= '' and hpp .. ' ' or '' ) .. '--slim'
+    rules[ #rules + 1 ] = table.concat{ ddl, '_accessors${OBJEXT}: ', ddl, '.h\n  ${CC:', flags, ddl, '_accessors.cpp}\n\n' }
+    files[ #files + 1 ] = table.concat( generated, ' ' )
+  end
+
+  exes[ #exes + 1 ] = test .. '${EXEEXT}'
+  rules[ #rules + 1 ] = table.concat{
+    ddl, '.h: ddlt~ddlt${EXEEXT} test~test.ddl\n  ', gen( 'hpp', ddl .. '.h', hpp ), '\n\n',
+    ddl, '.cpp: ddlt~ddlt${EXEEXT} test~test.ddl\n  ', gen( 'cpp -I test_' .. variant.name .. '_ddl.h', ddl .. '.cpp', variant.options ), '\n\n',
+    test, '_view_ddl.h: ddlt~ddlt${EXEEXT} test~test.ddl\n  ', gen( 'view', test .. '_view_ddl.h', variant.view ), '\n\n',
+    ddl, '${OBJEXT}: ', ddl, '.cpp ', ddl, '.h\n  ${CC:', flags, ddl, '.cpp}\n\n',
+    test, '${OBJEXT}: ${DEPS:test~test.cpp} ', ddl, '.h ', test, '_view_ddl.h test~test_soa_ddl.h test~bench_select_ddl.h\n  ${CC:', flags, '-D', variant.define, ' test~test.cpp}\n\n',
+    test, '${EXEEXT}: ', test, '${OBJEXT} ', objs, ' test~bench_select_ddl${OBJEXT} output~release~${LIB:ddlparser}\n  ${LINK}\n  echo "Running test_', variant.name, '..."\n  ', test, ' test~test.ddl test~bench_select.ddl\n\n'
+  }
+  files[ #files + 1 ] = table.concat( { ddl .. '.h', ddl .. '.cpp', test .. '_view_ddl.h', ddl .. '${OBJEXT}', test .. '${OBJEXT}', test .. '${EXEEXT}' }, ' ' )
+
+  if variant.bench then
+    local bench = 'test~bench_' .. variant.name
+
+    benches[ #benches + 1 ] = bench .. '${EXEEXT}'
+    runs[ #runs + 1 ] = '\n  echo "Running bench_' .. variant.name .. '..."\n  ' .. bench .. ' test~test.ddl test~bench_select.ddl'
+    rules[ #rules + 1 ] = table.concat{
+      bench, '${OBJEXT}: ${DEPS:test~bench.cpp} ', ddl, '.h ', test, '_view_ddl.h test~test_soa_ddl.h test~bench_select_ddl.h\n  ${CC:', flags, '-D', variant.define, ' test~bench.cpp}\n\n',
+      bench, '${EXEEXT}: ', bench, '${OBJEXT} ', objs, ' test~bench_select_ddl${OBJEXT} output~release~${LIB:ddlparser}\n  ${LINK}\n\n'
+    }
+    files[ #files + 1 ] = bench .. '${OBJEXT} ' .. bench .. '${EXEEXT}'
+  end
+end
+
+config.VARIANTEXES  = table.concat( exes, ' ' )
+config.VARIANTRULES = table.concat( rules )
+config.VARIANTFILES = table.concat( files, ' ' )
+config.VARIANTBENCHES = table.concat( benches, ' ' )
+config.VARIANTRUNS = table.concat( runs )
+
 local mkfile = [[
-all: output~debug~${LIB:ddlparser} output~release~${LIB:ddlparser} ddlt~ddlt${EXEEXT} test~test${EXEEXT} test~test_nacl${EXEEXT} README README.html README.md
+all: output~debug~${LIB:ddlparser} output~release~${LIB:ddlparser} ddlt~ddlt${EXEEXT} test~test${EXEEXT} test~test_nacl${EXEEXT} ${VARIANTEXES} README README.html README.md
 
 ##       ##       #### ########  ########     ###    ########  ##    ##
 ####     ##        ##  ##     ## ##     ##   ## ##   ##     ##  ##  ##
@@ -227,7 +323,7 @@ all: output~debug~${LIB:ddlparser} output~release~${LIB:ddlparser} ddlt~ddlt${EX
 ####     ##        ##  ##     ## ##    ##  ##     ## ##    ##     ##
 ##       ######## #### ########  ##     ## ##     ## ##     ##    ##
 
-LIBOBJSD=output~debug~AreaManager${OBJEXT} output~debug~DDLParser${OBJEXT} output~debug~Error${OBJEXT} output~debug~Hash${OBJEXT} output~debug~JSONChecker${OBJEXT} output~debug~Lexer${OBJEXT} output~debug~Parser${OBJEXT} output~debug~Str${OBJEXT} output~debug~StringArea${OBJEXT} output~debug~Value${OBJEXT}
+LIBOBJSD=output~debug~AreaManager${OBJEXT} output~debug~Container${OBJEXT} output~debug~DDLParser${OBJEXT} output~debug~Diff${OBJEXT} output~debug~Error${OBJEXT} output~debug~Hash${OBJEXT} output~debug~JSONChecker${OBJEXT} output~debug~Layout${OBJEXT} output~debug~Lexer${OBJEXT} output~debug~Migration${OBJEXT} output~debug~Parser${OBJEXT} output~debug~Serializer${OBJEXT} output~debug~Str${OBJEXT} output~debug~StringArea${OBJEXT} output~debug~Value${OBJEXT}
 
 output~debug~${LIB:ddlparser}: $(LIBOBJSD)
   ${LIB}
@@ -235,9 +331,15 @@ output~debug~${LIB:ddlparser}: $(LIBOBJSD)
 output~debug~AreaManager${OBJEXT}: ${DEPS:src~AreaManager.cpp}
   ${CCLIBD:src~AreaManager.cpp}
 
+output~debug~Container${OBJEXT}: ${DEPS:src~Container.cpp}
+  ${CCLIBD:src~Container.cpp}
+
 output~debug~DDLParser${OBJEXT}: ${DEPS:src~DDLParser.cpp}
   ${CCLIBD:src~DDLParser.cpp}
 
+output~debug~Diff${OBJEXT}: ${DEPS:src~Diff.cpp}
+  ${CCLIBD:src~Diff.cpp}
+
 output~debug~Error${OBJEXT}: ${DEPS:src~Error.cpp}
   ${CCLIBD:src~Error.cpp}
 
@@ -247,12 +349,21 @@ output~debug~Hash${OBJEXT}: ${DEPS:src~Hash.cpp}
 output~debug~JSONChecker${OBJEXT}: ${DEPS:src~JSONChecker.cpp}
   ${CCLIBD:src~JSONChecker.cpp}
 
+output~debug~Layout${OBJEXT}: ${DEPS:src~Layout.cpp}
+  ${CCLIBD:src~Layout.cpp}
+
 output~debug~Lexer${OBJEXT}: ${DEPS:src~Lexer.cpp} src~Tokens.inc
   ${CCLIBD:src~Lexer.cpp}
 
+output~debug~Migration${OBJEXT}: ${DEPS:src~Migration.cpp}
+  ${CCLIBD:src~Migration.cpp}
+
 output~debug~Parser${OBJEXT}: ${DEPS:src~Parser.cpp}
   ${CCLIBD:src~Parser.cpp}
 
+output~debug~Serializer${OBJEXT}: ${DEPS:src~Serializer.cpp}
+  ${CCLIBD:src~Serializer.cpp}
+
 output~debug~Str${OBJEXT}: ${DEPS:src~Str.cpp}
   ${CCLIBD:src~Str.cpp}
 
@@ -262,7 +373,7 @@ output~debug~StringArea${OBJEXT}: ${DEPS:src~StringArea.cpp}
 output~debug~Value${OBJEXT}: ${DEPS:src~Value.cpp}
   ${CCLIBD:src~Value.cpp}
 
-LIBOBJSR=output~release~AreaManager${OBJEXT} output~release~DDLParser${OBJEXT} output~release~Error${OBJEXT} output~release~Hash${OBJEXT} output~release~JSONChecker${OBJEXT} output~release~Lexer${OBJEXT} output~release~Parser${OBJEXT} output~release~Str${OBJEXT} output~release~StringArea${OBJEXT} output~release~Value${OBJEXT}
+LIBOBJSR=output~release~AreaManager${OBJEXT} output~release~Container${OBJEXT} output~release~DDLParser${OBJEXT} output~release~Diff${OBJEXT} output~release~Error${OBJEXT} output~release~Hash${OBJEXT} output~release~JSONChecker${OBJEXT} output~release~Layout${OBJEXT} output~release~Lexer${OBJEXT} output~release~Migration${OBJEXT} output~release~Parser${OBJEXT} output~release~Serializer${OBJEXT} output~release~Str${OBJEXT} output~release~StringArea${OBJEXT} output~release~Value${OBJEXT}
 
 output~release~${LIB:ddlparser}: $(LIBOBJSR)
   ${LIB}
@@ -270,9 +381,15 @@ output~release~${LIB:ddlparser}: $(LIBOBJSR)
 output~release~AreaManager${OBJEXT}: ${DEPS:src~AreaManager.cpp}
   ${CCLIB:src~AreaManager.cpp}
 
+output~release~Container${OBJEXT}: ${DEPS:src~Container.cpp}
+  ${CCLIB:src~Container.cpp}
+
 output~release~DDLParser${OBJEXT}: ${DEPS:src~DDLParser.cpp}
   ${CCLIB:src~DDLParser.cpp}
 
+output~release~Diff${OBJEXT}: ${DEPS:src~Diff.cpp}
+  ${CCLIB:src~Diff.cpp}
+
 output~release~Error${OBJEXT}: ${DEPS:src~Error.cpp}
   ${CCLIB:src~Error.cpp}
 
@@ -282,12 +399,21 @@ output~release~Hash${OBJEXT}: ${DEPS:src~Hash.cpp}
 output~release~JSONChecker${OBJEXT}: ${DEPS:src~JSONChecker.cpp}
   ${CCLIB:src~JSONChecker.cpp}
 
+output~release~Layout${OBJEXT}: ${DEPS:src~Layout.cpp}
+  ${CCLIB:src~Layout.cpp}
+
 output~release~Lexer${OBJEXT}: ${DEPS:src~Lexer.cpp} src~Tokens.inc
   ${CCLIB:src~Lexer.cpp}
 
+output~release~Migration${OBJEXT}: ${DEPS:src~Migration.cpp}
+  ${CCLIB:src~Migration.cpp}
+
 output~release~Parser${OBJEXT}: ${DEPS:src~Parser.cpp}
   ${CCLIB:src~Parser.cpp}
 
+output~release~Serializer${OBJEXT}: ${DEPS:src~Serializer.cpp}
+  ${CCLIB:src~Serializer.cpp}
+
 output~release~Str${OBJEXT}: ${DEPS:src~Str.cpp}
   ${CCLIB:src~Str.cpp}
 
@@ -374,15 +500,33 @@ test~test_ddl.cpp: ddlt~ddlt${EXEEXT} test~test.ddl
 test~test_ddl${OBJEXT}: test~test_ddl.cpp test~test_ddl.h
   ${CC:test~test_ddl.cpp}
 
-test~test${OBJEXT}: ${DEPS:test~test.cpp} test~test_ddl.h 
+test~test_view_ddl.h: ddlt~ddlt${EXEEXT} test~test.ddl
+  ddlt~ddlt -i test~test.ddl -t view -o test~test_view_ddl.h --search-path test
+
+test~test_soa_ddl.h: ddlt~ddlt${EXEEXT} test~test.ddl
+  ddlt~ddlt -i test~test.ddl -t soa -o test~test_soa_ddl.h --search-path test
+
+test~bench_select.ddl: util~createbench.lua
+  ${LUA} util~createbench.lua select 1000 > $@
+
+test~bench_select_ddl.h: ddlt~ddlt${EXEEXT} test~bench_select.ddl
+  ddlt~ddlt -i test~bench_select.ddl -t hpp -o test~bench_select_ddl.h --search-path test
+
+test~bench_select_ddl.cpp: ddlt~ddlt${EXEEXT} test~bench_select.ddl
+  ddlt~ddlt -i test~bench_select.ddl -t cpp -I bench_select_ddl.h -o test~bench_select_ddl.cpp --search-path test
+
+test~bench_select_ddl${OBJEXT}: test~bench_select_ddl.cpp test~bench_select_ddl.h
+  ${CC:test~bench_select_ddl.cpp}
+
+test~test${OBJEXT}: ${DEPS:test~test.cpp} test~test_ddl.h test~test_view_ddl.h test~test_soa_ddl.h test~bench_select_ddl.h
   ${CC:test~test.cpp}
 
-test~test${EXEEXT}: test~test${OBJEXT} test~test_ddl${OBJEXT}
+test~test${EXEEXT}: test~test${OBJEXT} test~test_ddl${OBJEXT} test~bench_select_ddl${OBJEXT} output~release~${LIB:ddlparser}
   ${LINK}
   echo "Running test..."
-  test~test
+  test~test test~test.ddl test~bench_select.ddl
 
-test~test_nacl_ddl.h: ddlt~ddlt${EXEEXT} test~test.ddl
+${VARIANTRULES}test~test_nacl_ddl.h: ddlt~ddlt${EXEEXT} test~test.ddl
   ddlt~ddlt -i test~test.ddl -t nacl_hpp -o test~test_nacl_ddl.h --search-path test
 
 test~test_nacl_ddl.cpp: ddlt~ddlt${EXEEXT} test~test.ddl
@@ -399,6 +543,42 @@ test~test_nacl${EXEEXT}: test~test_nacl${OBJEXT} test~test_nacl_ddl${OBJEXT}
   echo "Running test_nacl..."
   test~test_nacl
 
+test~bench${OBJEXT}: ${DEPS:test~bench.cpp} test~test_ddl.h test~test_view_ddl.h test~test_soa_ddl.h test~bench_select_ddl.h
+  ${CC:test~bench.cpp}
+
+test~bench${EXEEXT}: test~bench${OBJEXT} test~test_ddl${OBJEXT} test~bench_select_ddl${OBJEXT} output~release~${LIB:ddlparser}
+  ${LINK}
+
+test~bench_nacl${OBJEXT}: test~bench_nacl.cpp test~test_nacl_ddl.h
+  ${CC:test~bench_nacl.cpp}
+
+test~bench_nacl${EXEEXT}: test~bench_nacl${OBJEXT} test~test_nacl_ddl${OBJEXT}
+  ${LINK}
+
+bench: test~bench${EXEEXT} test~bench_nacl${EXEEXT} ${VARIANTBENCHES}
+  test~bench test~test.ddl test~bench_select.ddl
+  test~bench_nacl${VARIANTRUNS}
+
+test~bench_build.ddl: util~createbench.lua
+  ${LUA} util~createbench.lua 200 > $@
+
+test~bench_build_ddl.h: ddlt~ddlt${EXEEXT} test~bench_build.ddl
+  ddlt~ddlt -i test~bench_build.ddl -t hpp -o test~bench_build_ddl.h --search-path test
+
+test~bench_build_ddl.cpp: ddlt~ddlt${EXEEXT} test~bench_build.ddl
+  ddlt~ddlt -i test~bench_build.ddl -t cpp -I bench_build_ddl.h -o test~bench_build_ddl.cpp --search-path test
+
+test~bench_build_ddl_1.cpp: ddlt~ddlt${EXEEXT} test~bench_build.ddl
+  ddlt~ddlt -i test~bench_build.ddl -t cpp -I bench_build_ddl.h -o test~bench_build_ddl.cpp --shards ${SHARDS} --search-path test
+
+test~bench_build_ddl${OBJEXT}: test~bench_build_ddl.cpp test~bench_build_ddl.h
+  ${CC:test~bench_build_ddl.cpp}
+
+${SHARDRULES}bench_build: test~bench_build_ddl.h test~bench_build_ddl.cpp test~bench_build_ddl_1.cpp
+  ${RM} test~bench_build_ddl${OBJEXT} ${SHARDOBJS}
+  ${LUA} util~timecmd.lua ${SUBMAKE} test~bench_build_ddl${OBJEXT}
+  ${LUA} util~timecmd.lua ${SUBMAKE} ${SHARDOBJS}
+
 ##       ########   #######   ######  ##     ## ##     ## ######## ##    ## ########    ###    ######## ####  #######  ##    ##
 ####     ##     ## ##     ## ##    ## ##     ## ###   ### ##       ###   ##    ##      ## ##      ##     ##  ##     ## ###   ##
 ######   ##     ## ##     ## ##       ##     ## #### #### ##       ####  ##    ##     ##   ##     ##     ##  ##     ## ####  ##
@@ -442,8 +622,13 @@ clean:
   ${RM} output~release~${LIB:ddlparser} $(LIBOBJSR) output~release~ddlparser.pdb
   ${RM} ddlt~ddlt${EXEEXT} $(DDLTOBJS) ddlt~ddlc.h ddlt~ddlt.exp ddlt~ddlt.lib
   ${RM} etc~text2c${EXEEXT} etc~text2c${OBJEXT}
-  ${RM} test~test_ddl.h test~test_ddl.cpp test~test_ddl${OBJEXT} test~test${OBJEXT} test~test${EXEEXT}
+  ${RM} test~test_ddl.h test~test_ddl.cpp test~test_view_ddl.h test~test_soa_ddl.h test~test_ddl${OBJEXT} test~test${OBJEXT} test~test${EXEEXT}
+  ${RM} ${VARIANTFILES}
   ${RM} test~test_nacl_ddl.h test~test_nacl_ddl.cpp test~test_nacl_ddl${OBJEXT} test~test_nacl${OBJEXT} test~test_nacl${EXEEXT}
+  ${RM} test~bench${OBJEXT} test~bench${EXEEXT} test~bench_nacl${OBJEXT} test~bench_nacl${EXEEXT}
+  ${RM} test~bench_select.ddl test~bench_select_ddl.h test~bench_select_ddl.cpp test~bench_select_ddl${OBJEXT}
+  ${RM} test~bench_build.ddl test~bench_build_ddl.h test~bench_build_ddl.cpp test~bench_build_ddl${OBJEXT} test~bench_build_ddl_shared.h
+  ${RM} ${SHARDCPPS} ${SHARDOBJS}
   ${RM} util~text2c${EXEEXT} util~text2c${OBJEXT}
 ]]
 
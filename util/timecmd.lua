@@ -0,0 +1,13 @@
+if #arg == 0 then
+  io.write[[
+Runs a command and writes how long it took to run, in wall-clock seconds.
+
+Usage: lua timecmd.lua <command> [ <argument> ]...
+]]
+  os.exit()
+end
+
+local start = os.time()
+local status = os.execute( table.concat( arg, ' ' ) )
+io.write( string.format( '%.0f s: %s\n', os.difftime( os.time(), start ), table.concat( arg, ' ' ) ) )
+os.exit( status == 0 and 0 or 1 )